@@ -0,0 +1,130 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+// The deer / grain / ticks model equations, shared by proj2-4t, proj2-sweep and proj2-coro,
+// so there is only one copy of them to keep up to date.
+//
+// The step functions take the current state and the month's uniform 0.-1. random draws as arguments and return
+// the next value, so the threaded agents (globals), the sweep (one set of parameters per run) and the coroutines
+// (one state per ecosystem) all call the same code. A draw t stands for Ranf_r( &seed, low, high ) = low + t * (high - low),
+// computed the same way, so every program gets exactly the same numbers from the same random number stream.
+
+#include <stdlib.h>
+#include <math.h>
+
+// the model constants:
+struct params
+{
+    float GRAIN_GROWS_PER_MONTH;
+    float ONE_DEER_EATS_PER_MONTH;
+    float AVG_PRECIP_PER_MONTH; // average
+    float AMP_PRECIP_PER_MONTH; // plus or minus
+    float RANDOM_PRECIP;        // plus or minus noise
+    float AVG_TEMP;             // average
+    float AMP_TEMP;             // plus or minus
+    float RANDOM_TEMP;          // plus or minus noise
+    float MIDTEMP;
+    float MIDPRECIP;
+    float TICK_GROWTH_RATE; // positive effect of each deer on the ticks
+    float TICK_DECAY_RATE;  // negative effect of each inch of rain on the ticks
+    float LYME_LOW;         // the Lyme disease chance per million ticks is Ranf( LYME_LOW, LYME_HIGH )
+    float LYME_HIGH;
+};
+
+// the project's values:
+static const struct params DefaultParams =
+{
+    12.0, 1.0,
+    7.0, 6.0, 2.0,
+    60.0, 20.0, 10.0,
+    40.0, 10.0,
+    0.02, 0.01,
+    0.05, 0.13
+};
+
+// Re-entrant Random number generation function
+static inline float Ranf_r(unsigned int *seed, float low, float high)
+{
+    float r = (float)rand_r(seed); // 0 - RAND_MAX
+    float t = r / (float)RAND_MAX; // 0. - 1.
+
+    return low + t * (high - low);
+}
+
+// Function to calculate the square of a number
+static inline float SQR(float x)
+{
+    return x * x;
+}
+
+// the month's temperature and precipitation (cosAng, sinAng are the cos and sin of the month's angle, see MonthAngle( )):
+
+static inline float MonthAngle(int month)
+{
+    return (30. * (float)month + 15.) * (M_PI / 180.);
+}
+
+static inline void NextTempAndPrecip(const struct params *p, float cosAng, float sinAng, float tempDraw, float precipDraw,
+                                     float *temp, float *precip)
+{
+    float t = p->AVG_TEMP - p->AMP_TEMP * cosAng;
+    *temp = t + (-p->RANDOM_TEMP + tempDraw * (p->RANDOM_TEMP - -p->RANDOM_TEMP));
+    float r = p->AVG_PRECIP_PER_MONTH + p->AMP_PRECIP_PER_MONTH * sinAng;
+    *precip = r + (-p->RANDOM_PRECIP + precipDraw * (p->RANDOM_PRECIP - -p->RANDOM_PRECIP));
+    if (*precip < 0.)
+        *precip = 0.;
+}
+
+static inline int NextNumDeer(const struct params *p, int numDeer, float height, float tickPopulation,
+                              float lymeDraw, float deathDraw)
+{
+    int nextNumDeer = numDeer;
+    int carryingCapacity = (int)(height);
+
+    // Calculate the probability of a deer contracting Lyme disease and dying from ticks
+    float lymeDiseaseChance = (p->LYME_LOW + lymeDraw * (p->LYME_HIGH - p->LYME_LOW)) * tickPopulation;
+
+    if (nextNumDeer < carryingCapacity)
+        nextNumDeer++;
+    else if (nextNumDeer > carryingCapacity)
+        nextNumDeer--;
+
+    // Account for deer mortality due to Lyme disease
+    if (deathDraw < lymeDiseaseChance)
+        nextNumDeer--;
+
+    if (nextNumDeer < 0)
+        nextNumDeer = 0;
+
+    return nextNumDeer;
+}
+
+static inline float NextHeight(const struct params *p, float height, int numDeer, float temp, float precip)
+{
+    float tempFactor = exp(-SQR((temp - p->MIDTEMP) / 10.));
+    float precipFactor = exp(-SQR((precip - p->MIDPRECIP) / 10.));
+
+    float nextHeight = height;
+    nextHeight += tempFactor * precipFactor * p->GRAIN_GROWS_PER_MONTH;
+    nextHeight -= (float)numDeer * p->ONE_DEER_EATS_PER_MONTH;
+    if (nextHeight < 0.)
+        nextHeight = 0.;
+
+    return nextHeight;
+}
+
+static inline float NextTickPopulation(const struct params *p, float tickPopulation, int numDeer, float precip)
+{
+    float nextTickPopulation = tickPopulation;
+
+    // Adjust tick population based on environmental factors
+    nextTickPopulation *= (1.0 + p->TICK_GROWTH_RATE * numDeer); // Positive effect of deer on ticks
+    nextTickPopulation *= (1.0 - p->TICK_DECAY_RATE * precip);   // Negative effect of precipitation on ticks
+
+    if (nextTickPopulation < 0.0)
+        nextTickPopulation = 0.0;
+
+    return nextTickPopulation;
+}
+
+#endif
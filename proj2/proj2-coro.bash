@@ -0,0 +1,15 @@
+#!/bin/bash
+# months/sec of the threaded agents, the coroutine agents and an ensemble of coroutine ecosystems
+g++ -O2 proj2-4t.cpp -o proj2-4t -lm -fopenmp
+g++ -std=c++20 -O2 proj2-coro.cpp -o proj2-coro -lm -fopenmp
+
+./proj2-4t > output-4t.csv
+./proj2-coro > output-coro.csv
+cmp output-4t.csv output-coro.csv && echo "coroutine output is identical to the threaded output"
+
+for n in 1200 12000 120000
+do
+    ./proj2-4t -q -n $n > /dev/null
+    ./proj2-coro -q -n $n > /dev/null
+    ./proj2-coro -q -e 1000 -n $n > /dev/null
+done
@@ -0,0 +1,318 @@
+#include <stdio.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+#include <coroutine>
+#include <exception>
+
+#include "model.h"
+
+// Single-thread coroutine version of proj2-4t:
+// Deer, Grain, Ticks and Watcher are C++20 coroutines that co_await the same three barriers as the threaded agents,
+// and a cooperative scheduler resumes them in phase order on one thread. The output is identical to proj2-4t.
+// With -e N an ensemble of N independent ecosystems (seeds seed, seed+1, ...) is spread across the cores,
+// one ecosystem (4 coroutines) at a time per thread.
+//
+// compile with:  g++ -std=c++20 -O2 proj2-coro.cpp -o proj2-coro -lm -fopenmp
+
+// Seed for random number
+unsigned int seed = 0; // this is in the project notes
+
+// Necessary constants (see model.h)
+const struct params *Params = &DefaultParams;
+
+#define NUMAGENTS 4
+
+// Everything one simulation needs -- the globals of proj2-4t, one copy per ecosystem:
+struct ecosystem
+{
+    unsigned int seed;
+    int StartYear;
+    int NowYear;
+    int NowMonth;
+    float NowPrecip;
+    float NowTemp;
+    float NowHeight;
+    int NowNumDeer;
+    float NowTickPopulation;
+    long EndMonthNum;
+    long PrintFrom;   // the Watcher prints the months from this one on
+    int NumAtBarrier; // how many agents have reached the current barrier
+};
+
+void InitEcosystem(struct ecosystem *e, unsigned int seed, long endMonthNum, long printFrom)
+{
+    e->seed = seed;
+    e->StartYear = 2024;
+    e->NowYear = 2024;
+    e->NowMonth = 0;
+    e->NowPrecip = 3.0;
+    e->NowTemp = 60.5;
+    e->NowHeight = 5.0;
+    e->NowNumDeer = 2;
+    e->NowTickPopulation = 15.0;
+    e->EndMonthNum = endMonthNum;
+    e->PrintFrom = printFrom;
+    e->NumAtBarrier = 0;
+}
+
+long NowMonthNum(const struct ecosystem *e)
+{
+    return (long)(e->NowYear - e->StartYear) * 12 + e->NowMonth;
+}
+
+// Update Temperature and Precipitation
+void UpdateTempAndPrecip(struct ecosystem *e)
+{
+    float ang = MonthAngle(e->NowMonth);
+    float tempDraw = Ranf_r(&e->seed, 0., 1.);
+    float precipDraw = Ranf_r(&e->seed, 0., 1.);
+    NextTempAndPrecip(Params, cos(ang), sin(ang), tempDraw, precipDraw, &e->NowTemp, &e->NowPrecip);
+}
+
+// The coroutine an agent runs as. It starts suspended and the scheduler resumes it once per phase.
+struct agent
+{
+    struct promise_type
+    {
+        agent get_return_object() { return agent{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit agent(std::coroutine_handle<promise_type> h) : handle(h) {}
+    agent(agent &&other) : handle(other.handle) { other.handle = nullptr; }
+    agent(const agent &) = delete;
+    ~agent()
+    {
+        if (handle)
+            handle.destroy();
+    }
+};
+
+// co_await WaitBarrier(e) is the coroutine version of WaitBarrier(): the agent just checks in and suspends,
+// the scheduler only starts the next phase once every agent has checked in.
+struct barrier
+{
+    struct ecosystem *e;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<>) { e->NumAtBarrier++; }
+    void await_resume() {}
+};
+
+barrier WaitBarrier(struct ecosystem *e)
+{
+    return barrier{e};
+}
+
+// Deer Simulation
+agent Deer(struct ecosystem *e)
+{
+    while (NowMonthNum(e) < e->EndMonthNum)
+    {
+        // Compute a temporary next-value for this quantity based on the current state of the simulation:
+        float lymeDraw = Ranf_r(&e->seed, 0., 1.);
+        float deathDraw = Ranf_r(&e->seed, 0., 1.);
+        int nextNumDeer = NextNumDeer(Params, e->NowNumDeer, e->NowHeight, e->NowTickPopulation, lymeDraw, deathDraw);
+
+        // DoneComputing barrier:
+        co_await WaitBarrier(e);
+
+        e->NowNumDeer = nextNumDeer;
+
+        // DoneAssigning barrier:
+        co_await WaitBarrier(e);
+
+        // DonePrinting barrier:
+        co_await WaitBarrier(e);
+    }
+}
+
+// Grain Growth Simulation
+agent Grain(struct ecosystem *e)
+{
+    while (NowMonthNum(e) < e->EndMonthNum)
+    {
+        // Compute a temporary next-value for this quantity based on the current state of the simulation:
+        float nextHeight = NextHeight(Params, e->NowHeight, e->NowNumDeer, e->NowTemp, e->NowPrecip);
+
+        // DoneComputing barrier:
+        co_await WaitBarrier(e);
+
+        e->NowHeight = nextHeight;
+
+        // DoneAssigning barrier:
+        co_await WaitBarrier(e);
+
+        // DonePrinting barrier:
+        co_await WaitBarrier(e);
+    }
+}
+
+// Ticks Simulation
+agent Ticks(struct ecosystem *e)
+{
+    while (NowMonthNum(e) < e->EndMonthNum)
+    {
+        // Compute a temporary next-value for this quantity based on the current state of the simulation:
+        float nextTickPopulation = NextTickPopulation(Params, e->NowTickPopulation, e->NowNumDeer, e->NowPrecip);
+
+        // DoneComputing barrier:
+        co_await WaitBarrier(e);
+
+        e->NowTickPopulation = nextTickPopulation;
+
+        // DoneAssigning barrier:
+        co_await WaitBarrier(e);
+
+        // DonePrinting barrier:
+        co_await WaitBarrier(e);
+    }
+}
+
+// Watcher Simulation
+agent Watcher(struct ecosystem *e)
+{
+    while (NowMonthNum(e) < e->EndMonthNum)
+    {
+        // DoneComputing barrier:
+        co_await WaitBarrier(e);
+
+        // DoneAssigning barrier:
+        co_await WaitBarrier(e);
+
+        // Print the current set of global state variables:
+        if (NowMonthNum(e) >= e->PrintFrom)
+        {
+            float nowTempCelsius = (5.0 / 9.0) * (e->NowTemp - 32.0);
+            float nowPrecipCm = e->NowPrecip * 2.54;
+            float nowHeightCm = e->NowHeight * 2.54;
+            printf("%ld,%.2f,%.2f,%d,%.2f,%.1f\n",
+                   NowMonthNum(e), nowTempCelsius, nowPrecipCm, e->NowNumDeer, nowHeightCm, e->NowTickPopulation);
+        }
+
+        // Increment time:
+        e->NowMonth++;
+        if (e->NowMonth > 11)
+        {
+            e->NowMonth = 0;
+            e->NowYear++;
+        }
+
+        // Compute new environmental parameters:
+        UpdateTempAndPrecip(e);
+
+        // DonePrinting barrier:
+        co_await WaitBarrier(e);
+    }
+}
+
+// The cooperative scheduler: resume every agent once per phase, in agent order,
+// until they have all run off the end of their loops.
+void RunEcosystem(struct ecosystem *e)
+{
+    agent agents[NUMAGENTS] = { Deer(e), Grain(e), Ticks(e), Watcher(e) };
+
+    for (;;)
+    {
+        int numRunning = 0;
+        e->NumAtBarrier = 0;
+        for (int a = 0; a < NUMAGENTS; a++)
+        {
+            if (!agents[a].handle.done())
+            {
+                agents[a].handle.resume();
+                numRunning++;
+            }
+        }
+        if (numRunning == 0)
+            break;
+        if (e->NumAtBarrier != 0 && e->NumAtBarrier != NUMAGENTS)
+        {
+            fprintf(stderr, "Only %d of the %d agents reached the barrier!\n", e->NumAtBarrier, NUMAGENTS);
+            exit(1);
+        }
+    }
+}
+
+void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n months] [-q] [-e ensemble] [-s seed]\n", prog);
+    fprintf(stderr, "\t-n months    run until this many months since 2024 (default 72)\n");
+    fprintf(stderr, "\t-q           quiet: only print the last month, and the months/sec to stderr\n");
+    fprintf(stderr, "\t-e ensemble  run this many independent ecosystems across all the cores\n");
+    fprintf(stderr, "\t-s seed      seed of the (first) ecosystem (default 0, same as proj2-4t)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    long endMonthNum = 72;
+    bool quiet = false;
+    int ensemble = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-q") == 0)
+            quiet = true;
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            endMonthNum = atol(argv[++i]);
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+            ensemble = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (unsigned int)atol(argv[++i]);
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    double time0 = omp_get_wtime();
+    long totalMonths;
+
+    if (ensemble <= 0)
+    {
+        struct ecosystem e;
+        InitEcosystem(&e, seed, endMonthNum, quiet ? endMonthNum - 1 : 0);
+        if (!quiet)
+            printf("Month,Temp (C),Precip (cm),Deer,Height (cm),Ticks (millions)\n");
+        RunEcosystem(&e);
+        totalMonths = endMonthNum;
+    }
+    else
+    {
+        // the ecosystems are independent, so each thread just runs whole ones back-to-back:
+        struct ecosystem *eco = new struct ecosystem[ensemble];
+        float *finalHeight = new float[ensemble];
+#pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < ensemble; k++)
+        {
+            InitEcosystem(&eco[k], seed + k, endMonthNum, endMonthNum); // the members don't print, we print a summary instead
+            RunEcosystem(&eco[k]);
+            finalHeight[k] = eco[k].NowHeight;
+        }
+        double meanHeight = 0.;
+        for (int k = 0; k < ensemble; k++)
+            meanHeight += finalHeight[k];
+        printf("Ensemble,Months,Mean Final Height (cm)\n");
+        printf("%d,%ld,%.2f\n", ensemble, endMonthNum, meanHeight / ensemble * 2.54);
+        totalMonths = (long)ensemble * endMonthNum;
+        delete[] eco;
+        delete[] finalHeight;
+    }
+
+    double time1 = omp_get_wtime();
+    if (quiet)
+        fprintf(stderr, "%s : %ld months in %.3lf sec = %.3lf mega-months/sec\n",
+                ensemble > 0 ? "coroutine ensemble" : "coroutines",
+                totalMonths, time1 - time0, (double)totalMonths / (time1 - time0) / 1000000.);
+
+    return 0;
+}
@@ -0,0 +1,305 @@
+#include <stdio.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+
+#include "model.h"
+
+// Spatial version of the proj2 ecosystem:
+// every cell of a GRIDSIZE x GRIDSIZE landscape has its own grain height, deer density and tick population.
+// Deer migrate to the 4 neighbouring cells, ticks spread locally, and the landscape is split into
+// NUMREGIONS x NUMREGIONS regions that each get their own monthly temperature/precipitation.
+
+// setting the number of threads:
+#ifndef NUMT
+#define NUMT 4
+#endif
+
+// cells on a side of the landscape:
+#ifndef GRIDSIZE
+#define GRIDSIZE 4096
+#endif
+
+// weather regions on a side of the landscape (must divide GRIDSIZE):
+#ifndef NUMREGIONS
+#define NUMREGIONS 8
+#endif
+
+// cache block (tile) size on a side (should divide GRIDSIZE / NUMREGIONS so a tile never straddles two regions):
+#ifndef TILESIZE
+#define TILESIZE 64
+#endif
+
+// how many months to simulate (72 = 2024 - 2029, same as proj2-4t):
+#ifndef NUMMONTHS
+#define NUMMONTHS 72
+#endif
+
+#define REGIONSIZE (GRIDSIZE / NUMREGIONS)
+
+// row pitch including the 1-cell halo on each side:
+#define PITCH (GRIDSIZE + 2)
+
+// index of cell (x,y) in a field array, 0 <= x,y < GRIDSIZE:
+#define CELL(x, y) (((y) + 1) * PITCH + ((x) + 1))
+
+#define ALIGNED __attribute__((aligned(64)))
+
+// Seed for random number
+unsigned int seed = 0; // this is in the project notes
+
+// Necessary constants (see model.h)
+const struct params *Params = &DefaultParams;
+
+// spatial constants:
+const float DEER_MIGRATION = 0.20; // fraction of a cell's deer that wander off to the 4 neighbours each month
+const float TICK_SPREAD = 0.05;    // fraction of a cell's ticks that spread to the 4 neighbours each month
+
+// initial per-cell values (same as the proj2-4t starting state):
+const float START_HEIGHT = 5.0;
+const float START_DEER = 2.0;
+const float START_TICKS = 15.0;
+
+// Per-region weather, one entry per region:
+struct region
+{
+    unsigned int seed;
+    float temp;        // temperature Fahrenheit this month
+    float precip;      // in of rain per month
+    float growth;      // grain growth this month (what NextHeight( ) adds before the deer eat)
+    float tickFactor;  // tick population multiplier from precipitation
+    float lymeChance;  // per-tick deer mortality rate this month
+};
+
+struct region Regions[NUMREGIONS * NUMREGIONS];
+
+// Structure-of-arrays field storage, double buffered (Now* is read, New* is written, then they swap;
+// not Next*, that is what model.h calls its step functions):
+float *NowHeight, *NewHeight; // grain height in inches
+float *NowDeer, *NewDeer;     // deer per cell
+float *NowTicks, *NewTicks;   // ticks per cell (millions)
+
+int NowYear = 2024;
+int NowMonth = 0;
+
+// Update Temperature and Precipitation of one region (the model.h step functions, same as proj2-4t):
+void UpdateTempAndPrecip(struct region *r)
+{
+    float ang = MonthAngle(NowMonth);
+    float tempDraw = Ranf_r(&r->seed, 0., 1.);
+    float precipDraw = Ranf_r(&r->seed, 0., 1.);
+    NextTempAndPrecip(Params, cos(ang), sin(ang), tempDraw, precipDraw, &r->temp, &r->precip);
+
+    // hoist everything that only depends on the weather out of the per-cell loops:
+    // the growth of bare grain with no deer, and what one million ticks become with no deer
+    r->growth = NextHeight(Params, 0., 0, r->temp, r->precip);
+    r->tickFactor = NextTickPopulation(Params, 1., 0, r->precip);
+    r->lymeChance = Ranf_r(&r->seed, Params->LYME_LOW, Params->LYME_HIGH) / 1000.; // ticks are in millions per cell, this is per thousand
+}
+
+float *AllocField()
+{
+    float *f = (float *)aligned_alloc(64, ((sizeof(float) * PITCH * PITCH + 63) / 64) * 64);
+    if (f == NULL)
+    {
+        fprintf(stderr, "Cannot allocate a %d x %d field!\n", PITCH, PITCH);
+        exit(1);
+    }
+    return f;
+}
+
+// Copy the edge cells into the halo so the stencil sees a zero-flux boundary:
+void FillHalo(float *f)
+{
+    for (int x = 0; x < GRIDSIZE; x++)
+    {
+        f[CELL(x, -1)] = f[CELL(x, 0)];
+        f[CELL(x, GRIDSIZE)] = f[CELL(x, GRIDSIZE - 1)];
+    }
+    for (int y = -1; y <= GRIDSIZE; y++)
+    {
+        f[CELL(-1, y)] = f[CELL(0, y)];
+        f[CELL(GRIDSIZE, y)] = f[CELL(GRIDSIZE - 1, y)];
+    }
+}
+
+// Update one TILESIZE x TILESIZE block of cells from the Now* fields into the New* fields:
+void UpdateTile(int tx, int ty)
+{
+    int x0 = tx * TILESIZE;
+    int y0 = ty * TILESIZE;
+    struct region *r = &Regions[(y0 / REGIONSIZE) * NUMREGIONS + (x0 / REGIONSIZE)];
+    const float growth = r->growth;
+    const float tickFactor = r->tickFactor;
+    const float lymeChance = r->lymeChance;
+    const float deerEats = Params->ONE_DEER_EATS_PER_MONTH;
+    const float tickGrowth = Params->TICK_GROWTH_RATE;
+
+    for (int y = y0; y < y0 + TILESIZE; y++)
+    {
+        const float *__restrict h = &NowHeight[CELL(x0, y)];
+        const float *__restrict d = &NowDeer[CELL(x0, y)];
+        const float *__restrict dn = &NowDeer[CELL(x0, y - 1)];
+        const float *__restrict ds = &NowDeer[CELL(x0, y + 1)];
+        const float *__restrict t = &NowTicks[CELL(x0, y)];
+        const float *__restrict tn = &NowTicks[CELL(x0, y - 1)];
+        const float *__restrict ts = &NowTicks[CELL(x0, y + 1)];
+        float *__restrict hOut = &NewHeight[CELL(x0, y)];
+        float *__restrict dOut = &NewDeer[CELL(x0, y)];
+        float *__restrict tOut = &NewTicks[CELL(x0, y)];
+
+#pragma omp simd
+        for (int i = 0; i < TILESIZE; i++)
+        {
+            // Grain: grows with this region's weather and is eaten by the deer in the cell
+            float nextHeight = h[i] + growth - d[i] * deerEats;
+            nextHeight = fmaxf(nextHeight, 0.f);
+
+            // Deer: some wander in from / out to the neighbours, then drift towards the carrying capacity by at most one
+            float deer = (1.f - DEER_MIGRATION) * d[i] + (0.25f * DEER_MIGRATION) * (d[i - 1] + d[i + 1] + dn[i] + ds[i]);
+            deer += fminf(fmaxf(h[i] - deer, -1.f), 1.f);
+            deer -= deer * fminf(lymeChance * t[i], 1.f); // Lyme disease
+            deer = fmaxf(deer, 0.f);
+
+            // Ticks: spread to the neighbours, helped by deer and hurt by precipitation
+            float ticks = (1.f - TICK_SPREAD) * t[i] + (0.25f * TICK_SPREAD) * (t[i - 1] + t[i + 1] + tn[i] + ts[i]);
+            ticks *= (1.f + tickGrowth * d[i]) * tickFactor;
+            ticks = fmaxf(ticks, 0.f);
+
+            hOut[i] = nextHeight;
+            dOut[i] = deer;
+            tOut[i] = ticks;
+        }
+    }
+}
+
+void Swap(float **a, float **b)
+{
+    float *tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+int main(int argc, char *argv[])
+{
+    static_assert(GRIDSIZE % NUMREGIONS == 0, "NUMREGIONS must divide GRIDSIZE");
+    static_assert(REGIONSIZE % TILESIZE == 0, "TILESIZE must divide GRIDSIZE / NUMREGIONS");
+
+    omp_set_num_threads(NUMT);
+
+    NowHeight = AllocField();
+    NewHeight = AllocField();
+    NowDeer = AllocField();
+    NewDeer = AllocField();
+    NowTicks = AllocField();
+    NewTicks = AllocField();
+
+    // first-touch the fields with the same tile decomposition the updates use, so pages land near the threads using them:
+#pragma omp parallel for collapse(2) schedule(static)
+    for (int ty = 0; ty < GRIDSIZE / TILESIZE; ty++)
+    {
+        for (int tx = 0; tx < GRIDSIZE / TILESIZE; tx++)
+        {
+            for (int y = ty * TILESIZE; y < (ty + 1) * TILESIZE; y++)
+            {
+                for (int x = tx * TILESIZE; x < (tx + 1) * TILESIZE; x++)
+                {
+                    NowHeight[CELL(x, y)] = START_HEIGHT;
+                    NowDeer[CELL(x, y)] = START_DEER;
+                    NowTicks[CELL(x, y)] = START_TICKS;
+                    NewHeight[CELL(x, y)] = 0.;
+                    NewDeer[CELL(x, y)] = 0.;
+                    NewTicks[CELL(x, y)] = 0.;
+                }
+            }
+        }
+    }
+
+    for (int r = 0; r < NUMREGIONS * NUMREGIONS; r++)
+    {
+        Regions[r].seed = seed + r;
+        UpdateTempAndPrecip(&Regions[r]);
+    }
+
+    printf("Month,Temp (C),Precip (cm),Deer,Height (cm),Ticks (millions)\n");
+
+    double updateTime = 0.;
+    for (int m = 0; m < NUMMONTHS; m++)
+    {
+        double time0 = omp_get_wtime();
+
+        FillHalo(NowDeer);
+        FillHalo(NowTicks);
+
+#pragma omp parallel for collapse(2) schedule(static)
+        for (int ty = 0; ty < GRIDSIZE / TILESIZE; ty++)
+        {
+            for (int tx = 0; tx < GRIDSIZE / TILESIZE; tx++)
+            {
+                UpdateTile(tx, ty);
+            }
+        }
+
+        Swap(&NowHeight, &NewHeight);
+        Swap(&NowDeer, &NewDeer);
+        Swap(&NowTicks, &NewTicks);
+
+        double time1 = omp_get_wtime();
+        updateTime += time1 - time0;
+
+        // Print the landscape-wide averages (not timed):
+        double sumHeight = 0., sumDeer = 0., sumTicks = 0., sumTemp = 0., sumPrecip = 0.;
+#pragma omp parallel for reduction(+ : sumHeight, sumDeer, sumTicks)
+        for (int y = 0; y < GRIDSIZE; y++)
+        {
+            for (int x = 0; x < GRIDSIZE; x++)
+            {
+                sumHeight += NowHeight[CELL(x, y)];
+                sumDeer += NowDeer[CELL(x, y)];
+                sumTicks += NowTicks[CELL(x, y)];
+            }
+        }
+        for (int r = 0; r < NUMREGIONS * NUMREGIONS; r++)
+        {
+            sumTemp += Regions[r].temp;
+            sumPrecip += Regions[r].precip;
+        }
+        double numCells = (double)GRIDSIZE * (double)GRIDSIZE;
+        double numRegions = (double)(NUMREGIONS * NUMREGIONS);
+        float nowTempCelsius = (5.0 / 9.0) * (sumTemp / numRegions - 32.0);
+        float nowPrecipCm = sumPrecip / numRegions * 2.54;
+        float nowHeightCm = sumHeight / numCells * 2.54;
+        printf("%d,%.2f,%.2f,%.2f,%.2f,%.1f\n",
+               m, nowTempCelsius, nowPrecipCm, sumDeer / numCells, nowHeightCm, sumTicks / numCells);
+
+        // Increment time:
+        NowMonth++;
+        if (NowMonth > 11)
+        {
+            NowMonth = 0;
+            NowYear++;
+        }
+
+        // Compute new environmental parameters for every region:
+        for (int r = 0; r < NUMREGIONS * NUMREGIONS; r++)
+        {
+            UpdateTempAndPrecip(&Regions[r]);
+        }
+    }
+
+    double megaCellUpdatesPerSecond = (double)GRIDSIZE * (double)GRIDSIZE * (double)NUMMONTHS / updateTime / 1000000.;
+    fprintf(stderr, "%2d threads : %5d x %5d cells ; %4d months ; tile %3d ; mega-cell-updates/sec = %10.2lf\n",
+            NUMT, GRIDSIZE, GRIDSIZE, NUMMONTHS, TILESIZE, megaCellUpdatesPerSecond);
+
+    free(NowHeight);
+    free(NewHeight);
+    free(NowDeer);
+    free(NewDeer);
+    free(NowTicks);
+    free(NewTicks);
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+
+#include "model.h"
+
+// Parameter-sensitivity sweep of the proj2-4t model:
+// the model constants become per-run parameters, a grid or Latin-hypercube design of parameter sets is generated,
+// and the runs are spread across all the cores. Every run sees the same random number stream
+// (so with the default climate parameters they all get exactly the same weather), and the default parameter set
+// reproduces proj2-4t's numbers exactly.
+
+// Seed for random number
+unsigned int seed = 0; // this is in the project notes
+
+// the model constants of proj2-4t (struct params, in model.h), now one set per run:
+#define NUMPARAMS (sizeof(struct params) / sizeof(float))
+
+const char *ParamNames[NUMPARAMS] =
+{
+    "GRAIN_GROWS_PER_MONTH", "ONE_DEER_EATS_PER_MONTH",
+    "AVG_PRECIP_PER_MONTH", "AMP_PRECIP_PER_MONTH", "RANDOM_PRECIP",
+    "AVG_TEMP", "AMP_TEMP", "RANDOM_TEMP",
+    "MIDTEMP", "MIDPRECIP",
+    "TICK_GROWTH_RATE", "TICK_DECAY_RATE",
+    "LYME_LOW", "LYME_HIGH"
+};
+
+// what we remember about each run:
+struct summary
+{
+    float finalHeight;
+    int finalNumDeer;
+    float finalTickPopulation;
+    float meanHeight;
+    float meanNumDeer;
+    float meanTickPopulation;
+    int monthsWithoutDeer;
+};
+
+// The shared random number stream, 4 uniform 0.-1. numbers per month, in the order proj2-4t consumes them:
+// the 2 Deer() draws, then the 2 UpdateTempAndPrecip() noise draws.
+struct draws
+{
+    float lyme;   // Deer(): Ranf_r( &seed, 0.05, 0.13 )
+    float death;  // Deer(): Ranf_r( &seed, 0.0, 1.0 )
+    float temp;   // UpdateTempAndPrecip(): temperature noise
+    float precip; // UpdateTempAndPrecip(): precipitation noise
+};
+
+struct draws *Draws;
+float CosAng[12], SinAng[12];
+
+// Run one parameter set for numMonths months, starting from the proj2-4t initial state:
+void RunOne(const struct params *p, int numMonths, struct summary *out)
+{
+    int NowMonth = 0;
+    float NowPrecip = 3.0;
+    float NowTemp = 60.5;
+    float NowHeight = 5.0;
+    int NowNumDeer = 2;
+    float NowTickPopulation = 15.0;
+
+    double sumHeight = 0., sumNumDeer = 0., sumTickPopulation = 0.;
+    int monthsWithoutDeer = 0;
+
+    for (int m = 0; m < numMonths; m++)
+    {
+        const struct draws *d = &Draws[m];
+
+        int nextNumDeer = NextNumDeer(p, NowNumDeer, NowHeight, NowTickPopulation, d->lyme, d->death);
+        float nextHeight = NextHeight(p, NowHeight, NowNumDeer, NowTemp, NowPrecip);
+        float nextTickPopulation = NextTickPopulation(p, NowTickPopulation, NowNumDeer, NowPrecip);
+
+        NowNumDeer = nextNumDeer;
+        NowHeight = nextHeight;
+        NowTickPopulation = nextTickPopulation;
+
+        // Watcher:
+        sumHeight += NowHeight;
+        sumNumDeer += NowNumDeer;
+        sumTickPopulation += NowTickPopulation;
+        if (NowNumDeer == 0)
+            monthsWithoutDeer++;
+
+        NowMonth++;
+        if (NowMonth > 11)
+            NowMonth = 0;
+
+        NextTempAndPrecip(p, CosAng[NowMonth], SinAng[NowMonth], d->temp, d->precip, &NowTemp, &NowPrecip);
+    }
+
+    out->finalHeight = NowHeight;
+    out->finalNumDeer = NowNumDeer;
+    out->finalTickPopulation = NowTickPopulation;
+    out->meanHeight = sumHeight / numMonths;
+    out->meanNumDeer = sumNumDeer / numMonths;
+    out->meanTickPopulation = sumTickPopulation / numMonths;
+    out->monthsWithoutDeer = monthsWithoutDeer;
+}
+
+void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-d lhs|grid] [-N samples] [-L levels] [-m months] [-s seed] [-o file.csv] NAME=low:high ...\n", prog);
+    fprintf(stderr, "\t-d lhs|grid  Latin-hypercube (default) or full-grid design\n");
+    fprintf(stderr, "\t-N samples   number of Latin-hypercube parameter sets (default 10000)\n");
+    fprintf(stderr, "\t-L levels    grid levels per swept parameter (default 10)\n");
+    fprintf(stderr, "\t-m months    months to simulate per run (default 72)\n");
+    fprintf(stderr, "\t-s seed      seed of the shared random number stream (default 0, same as proj2-4t)\n");
+    fprintf(stderr, "\t-o file      write the summary table here instead of stdout\n");
+    fprintf(stderr, "\tparameters not given a range keep their proj2-4t values. The names are:\n");
+    for (int i = 0; i < (int)NUMPARAMS; i++)
+        fprintf(stderr, "\t\t%-24s (default %g)\n", ParamNames[i], ((const float *)&DefaultParams)[i]);
+}
+
+int main(int argc, char *argv[])
+{
+    bool grid = false;
+    int numSamples = 10000;
+    int numLevels = 10;
+    int numMonths = 72;
+    const char *outFile = NULL;
+
+    int numSwept = 0;
+    int swept[NUMPARAMS];
+    float low[NUMPARAMS], high[NUMPARAMS];
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            grid = strcmp(argv[++i], "grid") == 0;
+        else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc)
+            numSamples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc)
+            numLevels = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            numMonths = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (unsigned int)atol(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outFile = argv[++i];
+        else
+        {
+            const char *eq = strchr(argv[i], '=');
+            int which = -1;
+            for (int k = 0; eq != NULL && k < (int)NUMPARAMS; k++)
+            {
+                if (strlen(ParamNames[k]) == (size_t)(eq - argv[i]) && strncmp(argv[i], ParamNames[k], eq - argv[i]) == 0)
+                    which = k;
+            }
+            // each parameter can only be swept once (so there are at most NUMPARAMS ranges):
+            for (int j = 0; j < numSwept; j++)
+            {
+                if (swept[j] == which)
+                    which = -1;
+            }
+            float lo, hi;
+            if (which < 0 || numSwept >= (int)NUMPARAMS || sscanf(eq + 1, "%f:%f", &lo, &hi) != 2)
+            {
+                Usage(argv[0]);
+                return 1;
+            }
+            swept[numSwept] = which;
+            low[numSwept] = lo;
+            high[numSwept] = hi;
+            numSwept++;
+        }
+    }
+
+    if (numSwept == 0)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    // how many runs:
+    long numRuns = numSamples;
+    if (grid)
+    {
+        numRuns = 1;
+        for (int j = 0; j < numSwept; j++)
+            numRuns *= numLevels;
+    }
+
+    // generate the design:
+    struct params *design = new struct params[numRuns];
+    unsigned int designSeed = seed + 1;
+    if (grid)
+    {
+        for (long r = 0; r < numRuns; r++)
+        {
+            design[r] = DefaultParams;
+            long idx = r;
+            for (int j = 0; j < numSwept; j++)
+            {
+                int level = idx % numLevels;
+                idx /= numLevels;
+                float t = numLevels > 1 ? (float)level / (float)(numLevels - 1) : 0.5;
+                ((float *)&design[r])[swept[j]] = low[j] + t * (high[j] - low[j]);
+            }
+        }
+    }
+    else
+    {
+        // Latin hypercube: every swept parameter's range is cut into numRuns strata and each stratum is used exactly once
+        int *perm = new int[numRuns];
+        for (long r = 0; r < numRuns; r++)
+            design[r] = DefaultParams;
+        for (int j = 0; j < numSwept; j++)
+        {
+            for (long r = 0; r < numRuns; r++)
+                perm[r] = r;
+            for (long r = numRuns - 1; r > 0; r--)
+            {
+                long q = rand_r(&designSeed) % (r + 1);
+                int tmp = perm[r];
+                perm[r] = perm[q];
+                perm[q] = tmp;
+            }
+            for (long r = 0; r < numRuns; r++)
+            {
+                float t = ((float)perm[r] + Ranf_r(&designSeed, 0., 1.)) / (float)numRuns;
+                ((float *)&design[r])[swept[j]] = low[j] + t * (high[j] - low[j]);
+            }
+        }
+        delete[] perm;
+    }
+
+    // the shared random number stream, drawn in the same order as proj2-4t:
+    Draws = new struct draws[numMonths];
+    for (int m = 0; m < numMonths; m++)
+    {
+        Draws[m].lyme = Ranf_r(&seed, 0., 1.);
+        Draws[m].death = Ranf_r(&seed, 0., 1.);
+        Draws[m].temp = Ranf_r(&seed, 0., 1.);
+        Draws[m].precip = Ranf_r(&seed, 0., 1.);
+    }
+    for (int month = 0; month < 12; month++)
+    {
+        float ang = MonthAngle(month);
+        CosAng[month] = cos(ang);
+        SinAng[month] = sin(ang);
+    }
+
+    // run them all:
+    struct summary *results = new struct summary[numRuns];
+    double time0 = omp_get_wtime();
+#pragma omp parallel for schedule(dynamic, 64)
+    for (long r = 0; r < numRuns; r++)
+    {
+        RunOne(&design[r], numMonths, &results[r]);
+    }
+    double time1 = omp_get_wtime();
+
+    // write the summary table:
+    FILE *fp = stdout;
+    if (outFile != NULL)
+    {
+        fp = fopen(outFile, "w");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Error opening CSV file!\n");
+            return 1;
+        }
+    }
+    fprintf(fp, "Run");
+    for (int j = 0; j < numSwept; j++)
+        fprintf(fp, ",%s", ParamNames[swept[j]]);
+    fprintf(fp, ",Final Deer,Final Height (cm),Final Ticks (millions),Mean Deer,Mean Height (cm),Mean Ticks (millions),Months Without Deer\n");
+    for (long r = 0; r < numRuns; r++)
+    {
+        fprintf(fp, "%ld", r);
+        for (int j = 0; j < numSwept; j++)
+            fprintf(fp, ",%g", ((float *)&design[r])[swept[j]]);
+        struct summary *s = &results[r];
+        fprintf(fp, ",%d,%.2f,%.1f,%.2f,%.2f,%.1f,%d\n",
+                s->finalNumDeer, s->finalHeight * 2.54, s->finalTickPopulation,
+                s->meanNumDeer, s->meanHeight * 2.54, s->meanTickPopulation, s->monthsWithoutDeer);
+    }
+    if (fp != stdout)
+        fclose(fp);
+
+    fprintf(stderr, "%2d threads : %ld runs x %d months in %.3lf sec = %.1lf runs/sec, %.2lf mega-months/sec\n",
+            omp_get_max_threads(), numRuns, numMonths, time1 - time0,
+            (double)numRuns / (time1 - time0), (double)numRuns * numMonths / (time1 - time0) / 1000000.);
+
+    delete[] design;
+    delete[] results;
+    delete[] Draws;
+    return 0;
+}
@@ -0,0 +1,693 @@
+#ifndef CITIES_H
+#define CITIES_H
+
+// Runtime loader for the points (cities) to cluster.
+//
+// Two file formats:
+//
+//   CSV:     one point per line,  longitude , latitude [ , name ]
+//            (the name is everything after the second comma, so it may contain commas, e.g. "NewYork,NY";
+//            lines that don't start with a number, like a header line, are skipped)
+//            or, if the first line is a header whose third column is "weight",  longitude , latitude , weight [ , name ]
+//            parsed by NUMT threads, each one taking a newline-aligned slice of the memory-mapped file
+//
+//   binary:  a 64-byte header followed by all the float32 longitudes, then all the float32 latitudes,
+//            each array padded to a multiple of 16 floats (64 bytes) -- the same structure-of-arrays layout
+//            the clustering uses, so the file is memory-mapped and used in place (zero copy);
+//            if the header's flags have POINTS_WEIGHTED set, all the float32 weights follow, padded the same way
+//
+// LoadPoints( ) tells them apart by the header's magic number.
+//
+// A delta file lists the changes to a point file since it was last clustered, one change per line:
+//
+//   - number                                     delete point number 'number' (numbered as in the point file)
+//   + longitude , latitude [ , weight ] [ , name ]   insert a point (with a weight only if the point file has weights)
+//
+// ApplyPointDelta( ) keeps the points that are left in their order and puts the inserted ones after them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#define POINTS_MAGIC 0x31535450 // "PTS1"
+#define POINTS_VERSION 1
+#define POINTS_HEADERSIZE 64
+#define POINTS_PAD 16 // floats
+
+#define POINTS_WEIGHTED 0x1 // header flag: the file has a weight for every point
+
+struct pointsheader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint32_t flags; // POINTS_WEIGHTED, or 0
+    char unused[POINTS_HEADERSIZE - 20];
+};
+
+struct points
+{
+    int num;
+    float *longitude;
+    float *latitude;
+    float *weight;     // NULL if the file has no weights (every point counts once)
+    const char **name; // NULL if the file has no names
+
+    // where the memory came from, so FreePoints( ) knows how to give it back:
+    void *map;          // the memory-mapped file, if any
+    size_t mapBytes;
+    bool ownsArrays;    // longitude/latitude/weight were allocated (not pointing into the map)
+    char **ownedNames;  // names that had to be copied out of the file
+    int numOwnedNames;
+};
+
+static inline size_t PaddedCount(size_t n)
+{
+    return ((n + POINTS_PAD - 1) / POINTS_PAD) * POINTS_PAD;
+}
+
+static inline void *AllocAligned(size_t bytes)
+{
+    void *p = aligned_alloc(64, ((bytes + 63) / 64) * 64);
+    if (p == NULL)
+    {
+        fprintf(stderr, "Cannot allocate %lu bytes!\n", (unsigned long)bytes);
+        exit(1);
+    }
+    return p;
+}
+
+// does this line hold a point (as opposed to a header or a blank line)?
+static inline bool IsPointLine(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.');
+}
+
+// parse one number, never reading at or past end (the file is not NUL terminated):
+static inline const char *ParseFloat(const char *p, const char *end, float *f)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    // the common case, [-]ddd.ddd, is done exactly with one double division:
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int digits = 0, scale = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        mantissa = mantissa * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            digits++;
+            scale++;
+        }
+    }
+    if (digits == 0)
+        return NULL;
+    if (digits <= 15 && (p == end || (*p != 'e' && *p != 'E')))
+    {
+        static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+                                              1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+        double d = (double)mantissa / powersOfTen[scale];
+        *f = (float)(negative ? -d : d);
+        return p;
+    }
+
+    // anything else (long mantissas, exponents) goes through strtof on a bounded copy:
+    char buf[64];
+    int n = 0;
+    for (p = start; p < end && n < (int)sizeof(buf) - 1 && strchr("0123456789+-.eE", *p) != NULL; p++)
+        buf[n++] = *p;
+    buf[n] = '\0';
+    char *stop;
+    *f = strtof(buf, &stop);
+    return stop == buf ? NULL : start + (stop - buf);
+}
+
+// is the first line a header whose third column is "weight"?
+static inline bool HasWeightColumn(const char *map, size_t bytes)
+{
+    const char *end = (const char *)memchr(map, '\n', bytes);
+    if (end == NULL)
+        end = map + bytes;
+    if (IsPointLine(map, end))
+        return false;
+    const char *p = map;
+    for (int commas = 0; commas < 2; p++)
+    {
+        if (p >= end)
+            return false;
+        if (*p == ',')
+            commas++;
+    }
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return end - p >= 6 && strncasecmp(p, "weight", 6) == 0;
+}
+
+static inline bool LoadPointsCSV(const char *fileName, char *map, size_t bytes, int numThreads, struct points *pts)
+{
+    bool weighted = HasWeightColumn(map, bytes);
+
+    // slice the file into numThreads newline-aligned pieces:
+    size_t *sliceBegin = new size_t[numThreads + 1];
+    int *sliceCount = new int[numThreads + 1];
+    sliceBegin[0] = 0;
+    sliceBegin[numThreads] = bytes;
+    for (int t = 1; t < numThreads; t++)
+    {
+        size_t b = bytes * t / numThreads;
+        if (b < sliceBegin[t - 1])
+            b = sliceBegin[t - 1];
+        if (b < 1) // a file smaller than the number of threads: don't look at map[-1]
+            b = 1;
+        if (b > bytes)
+            b = bytes;
+        while (b < bytes && map[b - 1] != '\n')
+            b++;
+        sliceBegin[t] = b;
+    }
+
+    // pass 1: count the points in every slice
+#pragma omp parallel for num_threads(numThreads) schedule(static, 1)
+    for (int t = 0; t < numThreads; t++)
+    {
+        int count = 0;
+        const char *p = map + sliceBegin[t];
+        const char *end = map + sliceBegin[t + 1];
+        while (p < end)
+        {
+            const char *eol = (const char *)memchr(p, '\n', end - p);
+            if (eol == NULL)
+                eol = end;
+            if (IsPointLine(p, eol))
+                count++;
+            p = eol + 1;
+        }
+        sliceCount[t] = count;
+    }
+
+    // where every slice's points start:
+    int total = 0;
+    for (int t = 0; t < numThreads; t++)
+    {
+        int count = sliceCount[t];
+        sliceCount[t] = total;
+        total += count;
+    }
+
+    pts->num = total;
+    pts->longitude = (float *)AllocAligned(PaddedCount(total) * sizeof(float));
+    pts->latitude = (float *)AllocAligned(PaddedCount(total) * sizeof(float));
+    pts->weight = weighted ? (float *)AllocAligned(PaddedCount(total) * sizeof(float)) : NULL;
+    pts->name = new const char *[total];
+    pts->ownsArrays = true;
+
+    // pass 2: parse every slice straight into its part of the arrays
+    // (the map is private, so each name is NUL terminated in place by overwriting its newline)
+    bool ok = true;
+    const char *lastName = NULL;
+    int lastIndex = -1;
+#pragma omp parallel for num_threads(numThreads) schedule(static, 1) reduction(&& : ok)
+    for (int t = 0; t < numThreads; t++)
+    {
+        int i = sliceCount[t];
+        char *p = map + sliceBegin[t];
+        char *end = map + sliceBegin[t + 1];
+        while (p < end)
+        {
+            char *eol = (char *)memchr(p, '\n', end - p);
+            if (eol == NULL)
+                eol = end;
+            if (IsPointLine(p, eol))
+            {
+                const char *q = ParseFloat(p, eol, &pts->longitude[i]);
+                if (q != NULL)
+                {
+                    while (q < eol && (*q == ' ' || *q == '\t'))
+                        q++;
+                    q = (q < eol && *q == ',') ? ParseFloat(q + 1, eol, &pts->latitude[i]) : NULL;
+                }
+                if (q != NULL && weighted)
+                {
+                    while (q < eol && (*q == ' ' || *q == '\t'))
+                        q++;
+                    q = (q < eol && *q == ',') ? ParseFloat(q + 1, eol, &pts->weight[i]) : NULL;
+                }
+                if (q == NULL)
+                {
+                    fprintf(stderr, "'%s': cannot parse line '%.*s'\n", fileName, (int)(eol - p), p);
+                    ok = false;
+                    pts->latitude[i] = pts->longitude[i] = 0.;
+                    if (weighted)
+                        pts->weight[i] = 0.;
+                }
+                else
+                {
+                    while (q < eol && (*q == ' ' || *q == '\t'))
+                        q++;
+                    if (q < eol && *q == ',')
+                        q++;
+                    while (q < eol && (*q == ' ' || *q == '\t'))
+                        q++;
+                    char *nameEnd = eol;
+                    while (nameEnd > q && (nameEnd[-1] == '\r' || nameEnd[-1] == ' ' || nameEnd[-1] == '\t'))
+                        nameEnd--;
+                    if (eol < map + bytes)
+                    {
+                        *nameEnd = '\0';
+                        pts->name[i] = q;
+                    }
+                    else
+                    {
+                        // the last line has no newline to overwrite, copy this one name out below
+                        pts->name[i] = NULL;
+                        lastName = q;
+                        lastIndex = i;
+                    }
+                }
+                i++;
+            }
+            p = eol + 1;
+        }
+    }
+
+    pts->ownedNames = NULL;
+    pts->numOwnedNames = 0;
+    if (lastIndex >= 0)
+    {
+        const char *nameEnd = map + bytes;
+        while (nameEnd > lastName && (nameEnd[-1] == '\r' || nameEnd[-1] == ' ' || nameEnd[-1] == '\t'))
+            nameEnd--;
+        pts->ownedNames = new char *[1];
+        pts->ownedNames[0] = strndup(lastName, nameEnd - lastName);
+        pts->numOwnedNames = 1;
+        pts->name[lastIndex] = pts->ownedNames[0];
+    }
+
+    delete[] sliceBegin;
+    delete[] sliceCount;
+    return ok;
+}
+
+// Load a CSV or binary point file. Returns false (after saying why) if it can't.
+static inline bool LoadPoints(const char *fileName, int numThreads, struct points *pts)
+{
+    memset(pts, 0, sizeof(*pts));
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot open data file '%s'\n", fileName);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t bytes = st.st_size;
+    if (bytes == 0)
+    {
+        fprintf(stderr, "Data file '%s' is empty\n", fileName);
+        close(fd);
+        return false;
+    }
+
+    struct pointsheader header;
+    bool binary = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && header.magic == POINTS_MAGIC;
+
+    double time0 = omp_get_wtime();
+    bool ok;
+    if (binary)
+    {
+        // zero copy: the arrays are used right where they sit in the (read-only, shared) mapping
+        size_t padded = PaddedCount(header.count);
+        int numArrays = (header.flags & POINTS_WEIGHTED) ? 3 : 2;
+        ok = header.version == POINTS_VERSION && bytes >= POINTS_HEADERSIZE + numArrays * padded * sizeof(float) && header.count < (1u << 31);
+        if (!ok)
+        {
+            fprintf(stderr, "'%s' is a truncated or unknown version binary point file\n", fileName);
+        }
+        else
+        {
+            pts->map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+            pts->mapBytes = bytes;
+            if (pts->map == MAP_FAILED)
+            {
+                fprintf(stderr, "Cannot map data file '%s'\n", fileName);
+                pts->map = NULL;
+                ok = false;
+            }
+            else
+            {
+                // touch every page now (in parallel), so the faults are paid here and the load rate is real:
+                madvise(pts->map, bytes, MADV_WILLNEED);
+                const volatile char *page = (const volatile char *)pts->map;
+                long numPages = (bytes + 4095) / 4096;
+#pragma omp parallel for num_threads(numThreads)
+                for (long pg = 0; pg < numPages; pg++)
+                    (void)page[pg * 4096];
+
+                pts->num = (int)header.count;
+                pts->longitude = (float *)((char *)pts->map + POINTS_HEADERSIZE);
+                pts->latitude = pts->longitude + padded;
+                pts->weight = (header.flags & POINTS_WEIGHTED) ? pts->latitude + padded : NULL;
+                pts->name = NULL;
+                pts->ownsArrays = false;
+            }
+        }
+    }
+    else
+    {
+        // private and writable, so the names can be NUL terminated in place (copy on write)
+        pts->map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        pts->mapBytes = bytes;
+        if (pts->map == MAP_FAILED)
+        {
+            fprintf(stderr, "Cannot map data file '%s'\n", fileName);
+            pts->map = NULL;
+            ok = false;
+        }
+        else
+        {
+            madvise(pts->map, bytes, MADV_SEQUENTIAL);
+            ok = LoadPointsCSV(fileName, (char *)pts->map, bytes, numThreads, pts);
+        }
+    }
+    double time1 = omp_get_wtime();
+    close(fd);
+
+    if (ok)
+        fprintf(stderr, "loaded %d %spoints from '%s' (%s) : %.1lf MB in %.4lf sec = %.1lf MB/s\n",
+                pts->num, pts->weight != NULL ? "weighted " : "", fileName, binary ? "binary, mapped" : "CSV", (double)bytes / 1.e6, time1 - time0,
+                (double)bytes / 1.e6 / (time1 - time0));
+    return ok;
+}
+
+// Write points in the binary format:
+static inline bool WritePointsBinary(const char *fileName, const struct points *pts)
+{
+    FILE *fp = fopen(fileName, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Cannot write data file '%s'\n", fileName);
+        return false;
+    }
+    struct pointsheader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = POINTS_MAGIC;
+    header.version = POINTS_VERSION;
+    header.count = pts->num;
+    header.flags = pts->weight != NULL ? POINTS_WEIGHTED : 0;
+
+    size_t padded = PaddedCount(pts->num);
+    float zeros[POINTS_PAD] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(pts->longitude, sizeof(float), pts->num, fp) == (size_t)pts->num;
+    ok = ok && fwrite(zeros, sizeof(float), padded - pts->num, fp) == padded - pts->num;
+    ok = ok && fwrite(pts->latitude, sizeof(float), pts->num, fp) == (size_t)pts->num;
+    ok = ok && fwrite(zeros, sizeof(float), padded - pts->num, fp) == padded - pts->num;
+    if (pts->weight != NULL)
+    {
+        ok = ok && fwrite(pts->weight, sizeof(float), pts->num, fp) == (size_t)pts->num;
+        ok = ok && fwrite(zeros, sizeof(float), padded - pts->num, fp) == padded - pts->num;
+    }
+    fclose(fp);
+    if (!ok)
+        fprintf(stderr, "Cannot write data file '%s'\n", fileName);
+    return ok;
+}
+
+static inline void FreePoints(struct points *pts)
+{
+    if (pts->ownsArrays)
+    {
+        free(pts->longitude);
+        free(pts->latitude);
+        free(pts->weight);
+    }
+    delete[] pts->name;
+    for (int i = 0; i < pts->numOwnedNames; i++)
+        free(pts->ownedNames[i]);
+    delete[] pts->ownedNames;
+    if (pts->map != NULL)
+        munmap(pts->map, pts->mapBytes);
+    memset(pts, 0, sizeof(*pts));
+}
+
+struct pointdelta
+{
+    int numDeletes;
+    int *deletes;
+    int numInserts;
+    float *longitude; // the inserted points
+    float *latitude;
+    float *weight;    // NULL if the point file has no weights
+    char **name;      // NULL where an inserted point has no name
+};
+
+static inline void FreePointDelta(struct pointdelta *d)
+{
+    delete[] d->deletes;
+    delete[] d->longitude;
+    delete[] d->latitude;
+    delete[] d->weight;
+    for (int i = 0; i < d->numInserts; i++)
+        free(d->name[i]);
+    delete[] d->name;
+    memset(d, 0, sizeof(*d));
+}
+
+// Load a delta file (small, so read serially), for a point file with or without weights.
+// Returns false (after saying why) if it can't.
+static inline bool LoadPointDelta(const char *fileName, bool weighted, struct pointdelta *d)
+{
+    memset(d, 0, sizeof(*d));
+    FILE *fp = fopen(fileName, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Cannot open delta file '%s'\n", fileName);
+        return false;
+    }
+
+    // count the changes first, so every array is allocated once:
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, fp)) >= 0)
+    {
+        if (length > 0 && line[0] == '-')
+            d->numDeletes++;
+        else if (length > 0 && line[0] == '+')
+            d->numInserts++;
+    }
+    d->deletes = new int[d->numDeletes];
+    d->longitude = new float[d->numInserts];
+    d->latitude = new float[d->numInserts];
+    d->weight = weighted ? new float[d->numInserts] : NULL;
+    d->name = new char *[d->numInserts]();
+
+    rewind(fp);
+    bool ok = true;
+    int numDeletes = 0, numInserts = 0;
+    while (ok && (length = getline(&line, &capacity, fp)) >= 0)
+    {
+        const char *end = line + length;
+        while (end > line && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+            end--;
+        if (end == line || (line[0] != '-' && line[0] != '+'))
+            continue; // blank lines and comments
+
+        if (line[0] == '-')
+        {
+            char *stop;
+            long number = strtol(line + 1, &stop, 10);
+            ok = stop != line + 1 && number >= 0 && number < (1L << 31);
+            if (ok)
+                d->deletes[numDeletes++] = (int)number;
+        }
+        else
+        {
+            int i = numInserts++;
+            const char *q = ParseFloat(line + 1, end, &d->longitude[i]);
+            while (q != NULL && q < end && (*q == ' ' || *q == '\t'))
+                q++;
+            q = (q != NULL && q < end && *q == ',') ? ParseFloat(q + 1, end, &d->latitude[i]) : NULL;
+            if (q != NULL && weighted)
+            {
+                while (q < end && (*q == ' ' || *q == '\t'))
+                    q++;
+                q = (q < end && *q == ',') ? ParseFloat(q + 1, end, &d->weight[i]) : NULL;
+            }
+            ok = q != NULL;
+            if (ok)
+            {
+                while (q < end && (*q == ' ' || *q == '\t' || *q == ','))
+                    q++;
+                if (q < end)
+                    d->name[i] = strndup(q, end - q);
+            }
+        }
+        if (!ok)
+            fprintf(stderr, "'%s': cannot parse line '%.*s'\n", fileName, (int)(end - line), line);
+    }
+    free(line);
+    fclose(fp);
+    if (!ok)
+        FreePointDelta(d);
+    return ok;
+}
+
+// Delete and insert the delta's points. oldToNew[j] becomes point j's new number, or -1 if it was deleted.
+// Returns false (after saying why) if the delta deletes a point the file doesn't have.
+static inline bool ApplyPointDelta(struct points *pts, const struct pointdelta *d, int *oldToNew)
+{
+    int oldNum = pts->num;
+#pragma omp parallel for
+    for (int j = 0; j < oldNum; j++)
+        oldToNew[j] = 0;
+    for (int c = 0; c < d->numDeletes; c++)
+    {
+        if (d->deletes[c] < 0 || d->deletes[c] >= oldNum)
+        {
+            fprintf(stderr, "The delta deletes point %d, but there are only %d\n", d->deletes[c], oldNum);
+            return false;
+        }
+        oldToNew[d->deletes[c]] = -1;
+    }
+    int num = 0;
+    for (int j = 0; j < oldNum; j++)
+        oldToNew[j] = oldToNew[j] < 0 ? -1 : num++;
+    int numKept = num;
+    num += d->numInserts;
+
+    float *longitude = (float *)AllocAligned(PaddedCount(num) * sizeof(float));
+    float *latitude = (float *)AllocAligned(PaddedCount(num) * sizeof(float));
+    float *weight = pts->weight != NULL ? (float *)AllocAligned(PaddedCount(num) * sizeof(float)) : NULL;
+    const char **name = pts->name != NULL ? new const char *[num] : NULL;
+#pragma omp parallel for
+    for (int j = 0; j < oldNum; j++)
+    {
+        int i = oldToNew[j];
+        if (i < 0)
+            continue;
+        longitude[i] = pts->longitude[j];
+        latitude[i] = pts->latitude[j];
+        if (weight != NULL)
+            weight[i] = pts->weight[j];
+        if (name != NULL)
+            name[i] = pts->name[j]; // still pointing into the map, or at an owned name
+    }
+
+    // the inserted names are copied, so the delta can be freed:
+    char **ownedNames = pts->ownedNames;
+    if (name != NULL)
+    {
+        ownedNames = new char *[pts->numOwnedNames + d->numInserts];
+        for (int c = 0; c < pts->numOwnedNames; c++)
+            ownedNames[c] = pts->ownedNames[c];
+        delete[] pts->ownedNames;
+    }
+    for (int c = 0; c < d->numInserts; c++)
+    {
+        int i = numKept + c;
+        longitude[i] = d->longitude[c];
+        latitude[i] = d->latitude[c];
+        if (weight != NULL)
+            weight[i] = d->weight[c];
+        if (name != NULL)
+        {
+            name[i] = ownedNames[pts->numOwnedNames++] = strdup(d->name[c] != NULL ? d->name[c] : "");
+        }
+    }
+
+    if (pts->ownsArrays)
+    {
+        free(pts->longitude);
+        free(pts->latitude);
+        free(pts->weight);
+    }
+    delete[] pts->name;
+    pts->num = num;
+    pts->longitude = longitude;
+    pts->latitude = latitude;
+    pts->weight = weight;
+    pts->name = name;
+    pts->ownedNames = ownedNames;
+    pts->ownsArrays = true;
+    return true;
+}
+
+// A binary point file read a batch at a time, for point sets that don't have to (or can't) fit in memory:
+struct pointstream
+{
+    int fd;
+    int num;
+    off_t longitudeOffset; // where the longitudes and the latitudes start in the file
+    off_t latitudeOffset;
+};
+
+static inline bool OpenPointStream(const char *fileName, struct pointstream *ps)
+{
+    ps->fd = open(fileName, O_RDONLY);
+    if (ps->fd < 0)
+    {
+        fprintf(stderr, "Cannot open data file '%s'\n", fileName);
+        return false;
+    }
+    struct pointsheader header;
+    if (pread(ps->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != POINTS_MAGIC ||
+        header.version != POINTS_VERSION || header.count >= (1u << 31))
+    {
+        fprintf(stderr, "'%s' is not a binary point file (proj03 -w makes one)\n", fileName);
+        close(ps->fd);
+        return false;
+    }
+    ps->num = (int)header.count;
+    ps->longitudeOffset = POINTS_HEADERSIZE;
+    ps->latitudeOffset = POINTS_HEADERSIZE + PaddedCount(header.count) * sizeof(float);
+    posix_fadvise(ps->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+// read points start .. start+n-1 (fewer at the end of the file); returns how many were read
+static inline int ReadPointBatch(struct pointstream *ps, int start, int n, float *longitude, float *latitude)
+{
+    if (start + n > ps->num)
+        n = ps->num - start;
+    if (n <= 0)
+        return 0;
+    size_t bytes = (size_t)n * sizeof(float);
+    if (pread(ps->fd, longitude, bytes, ps->longitudeOffset + (off_t)start * sizeof(float)) != (ssize_t)bytes ||
+        pread(ps->fd, latitude, bytes, ps->latitudeOffset + (off_t)start * sizeof(float)) != (ssize_t)bytes)
+    {
+        fprintf(stderr, "Cannot read points %d-%d\n", start, start + n - 1);
+        return 0;
+    }
+    return n;
+}
+
+static inline void ClosePointStream(struct pointstream *ps)
+{
+    close(ps->fd);
+    ps->fd = -1;
+}
+
+#endif
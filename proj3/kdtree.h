@@ -0,0 +1,245 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+// A static 2D k-d tree for nearest-neighbour and k-nearest-neighbour queries.
+//
+// The tree is implicit: the points are reordered so that the range [lo,hi) of every subtree has its split point at
+// mid = (lo+hi)/2, the points left of the split in [lo,mid) and the ones right of it in [mid+1,hi). Ranges of
+// KDLEAF points or fewer are leaves that are scanned. Each split is on the longer side of its subtree's box.
+// Building is parallel (omp tasks), and the batched queries run one query per iteration of an omp parallel for.
+//
+// Ties are broken toward the lowest point number, like a brute-force scan with < would.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <omp.h>
+
+#define KDLEAF 8             // scan ranges this small instead of splitting them
+#define KDTASKSIZE (1 << 14) // build subtrees at least this big as separate omp tasks
+
+struct kdtree
+{
+    int num;
+    float *x;           // the points, in tree order
+    float *y;
+    int *index;         // the number each point had when it was given to BuildKdTree( )
+    unsigned char *dim; // the split axis of each split point, 0 = x, 1 = y
+};
+
+struct kdpoint
+{
+    float x, y;
+    int index;
+};
+
+// (xmin..xmax, ymin..ymax is a box around the range's points: the parent's box, cut at the parent's split)
+static inline void BuildKdRange(struct kdtree *t, struct kdpoint *p, int lo, int hi, float xmin, float xmax, float ymin, float ymax)
+{
+    if (hi - lo <= KDLEAF)
+        return;
+
+    unsigned char dim = (xmax - xmin) >= (ymax - ymin) ? 0 : 1;
+    int mid = (lo + hi) / 2;
+    if (dim == 0)
+        std::nth_element(p + lo, p + mid, p + hi, [](const kdpoint &a, const kdpoint &b) { return a.x < b.x; });
+    else
+        std::nth_element(p + lo, p + mid, p + hi, [](const kdpoint &a, const kdpoint &b) { return a.y < b.y; });
+    t->dim[mid] = dim;
+    float split = dim == 0 ? p[mid].x : p[mid].y;
+
+#pragma omp task default(shared) firstprivate(xmin, xmax, ymin, ymax) if (mid - lo >= KDTASKSIZE)
+    BuildKdRange(t, p, lo, mid, xmin, dim == 0 ? split : xmax, ymin, dim == 1 ? split : ymax);
+#pragma omp task default(shared) firstprivate(xmin, xmax, ymin, ymax) if (hi - mid - 1 >= KDTASKSIZE)
+    BuildKdRange(t, p, mid + 1, hi, dim == 0 ? split : xmin, xmax, dim == 1 ? split : ymin, ymax);
+#pragma omp taskwait
+}
+
+// build a tree over the n points (x[i], y[i]), using the threads omp would give a parallel region:
+static inline void BuildKdTree(const float *x, const float *y, int n, struct kdtree *t)
+{
+    struct kdpoint *p = new struct kdpoint[n];
+    t->num = n;
+    t->x = new float[n];
+    t->y = new float[n];
+    t->index = new int[n];
+    t->dim = new unsigned char[n];
+
+    float xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY;
+#pragma omp parallel for reduction(min : xmin, ymin) reduction(max : xmax, ymax)
+    for (int i = 0; i < n; i++)
+    {
+        p[i].x = x[i];
+        p[i].y = y[i];
+        p[i].index = i;
+        t->dim[i] = 0;
+        xmin = fminf(xmin, x[i]);
+        xmax = fmaxf(xmax, x[i]);
+        ymin = fminf(ymin, y[i]);
+        ymax = fmaxf(ymax, y[i]);
+    }
+
+#pragma omp parallel
+#pragma omp single
+    BuildKdRange(t, p, 0, n, xmin, xmax, ymin, ymax);
+
+    // and back to structure of arrays for the searches:
+#pragma omp parallel for
+    for (int i = 0; i < n; i++)
+    {
+        t->x[i] = p[i].x;
+        t->y[i] = p[i].y;
+        t->index[i] = p[i].index;
+    }
+    delete[] p;
+}
+
+static inline void FreeKdTree(struct kdtree *t)
+{
+    delete[] t->x;
+    delete[] t->y;
+    delete[] t->index;
+    delete[] t->dim;
+    t->num = 0;
+}
+
+// is (d2, index) closer than (bestd2, bestindex)?
+static inline bool KdCloser(float d2, int index, float bestd2, int bestindex)
+{
+    return d2 < bestd2 || (d2 == bestd2 && index < bestindex);
+}
+
+static inline void KdNearestRange(const struct kdtree *t, int lo, int hi, float qx, float qy, int *best, float *bestd2)
+{
+    while (hi - lo > KDLEAF)
+    {
+        int mid = (lo + hi) / 2;
+        float dx = qx - t->x[mid];
+        float dy = qy - t->y[mid];
+        float d2 = dx * dx + dy * dy;
+        if (KdCloser(d2, t->index[mid], *bestd2, *best))
+        {
+            *bestd2 = d2;
+            *best = t->index[mid];
+        }
+
+        // the side the query is on first, then the other side if the best circle crosses the split:
+        float diff = t->dim[mid] == 0 ? dx : dy;
+        if (diff < 0.)
+        {
+            KdNearestRange(t, lo, mid, qx, qy, best, bestd2);
+            if (diff * diff > *bestd2)
+                return;
+            lo = mid + 1;
+        }
+        else
+        {
+            KdNearestRange(t, mid + 1, hi, qx, qy, best, bestd2);
+            if (diff * diff > *bestd2)
+                return;
+            hi = mid;
+        }
+    }
+
+    for (int i = lo; i < hi; i++)
+    {
+        float dx = qx - t->x[i];
+        float dy = qy - t->y[i];
+        float d2 = dx * dx + dy * dy;
+        if (KdCloser(d2, t->index[i], *bestd2, *best))
+        {
+            *bestd2 = d2;
+            *best = t->index[i];
+        }
+    }
+}
+
+// the number of the point nearest to (qx, qy), and its squared distance:
+static inline int KdNearest(const struct kdtree *t, float qx, float qy, float *d2)
+{
+    int best = -1;
+    float bestd2 = INFINITY;
+    KdNearestRange(t, 0, t->num, qx, qy, &best, &bestd2);
+    *d2 = bestd2;
+    return best;
+}
+
+// offer point i to a k-nearest list that is sorted nearest first:
+static inline void KdOffer(const struct kdtree *t, int i, float qx, float qy, int k, int *indices, float *d2s)
+{
+    float dx = qx - t->x[i];
+    float dy = qy - t->y[i];
+    float d2 = dx * dx + dy * dy;
+    int index = t->index[i];
+    if (!KdCloser(d2, index, d2s[k - 1], indices[k - 1]))
+        return;
+    int j = k - 1;
+    while (j > 0 && KdCloser(d2, index, d2s[j - 1], indices[j - 1]))
+    {
+        d2s[j] = d2s[j - 1];
+        indices[j] = indices[j - 1];
+        j--;
+    }
+    d2s[j] = d2;
+    indices[j] = index;
+}
+
+static inline void KdNearestKRange(const struct kdtree *t, int lo, int hi, float qx, float qy, int k, int *indices, float *d2s)
+{
+    while (hi - lo > KDLEAF)
+    {
+        int mid = (lo + hi) / 2;
+        KdOffer(t, mid, qx, qy, k, indices, d2s);
+
+        float diff = t->dim[mid] == 0 ? qx - t->x[mid] : qy - t->y[mid];
+        if (diff < 0.)
+        {
+            KdNearestKRange(t, lo, mid, qx, qy, k, indices, d2s);
+            if (diff * diff > d2s[k - 1])
+                return;
+            lo = mid + 1;
+        }
+        else
+        {
+            KdNearestKRange(t, mid + 1, hi, qx, qy, k, indices, d2s);
+            if (diff * diff > d2s[k - 1])
+                return;
+            hi = mid;
+        }
+    }
+
+    for (int i = lo; i < hi; i++)
+        KdOffer(t, i, qx, qy, k, indices, d2s);
+}
+
+// the numbers of the k points nearest to (qx, qy), nearest first, and their squared distances
+// (if there are fewer than k points, the rest of the list is -1 and infinity):
+static inline void KdNearestK(const struct kdtree *t, float qx, float qy, int k, int *indices, float *d2s)
+{
+    for (int j = 0; j < k; j++)
+    {
+        indices[j] = -1;
+        d2s[j] = INFINITY;
+    }
+    KdNearestKRange(t, 0, t->num, qx, qy, k, indices, d2s);
+}
+
+// the nearest point to each of the nq queries, in parallel:
+static inline void KdNearestBatch(const struct kdtree *t, const float *qx, const float *qy, int nq, int *indices, float *d2s)
+{
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int q = 0; q < nq; q++)
+        indices[q] = KdNearest(t, qx[q], qy[q], &d2s[q]);
+}
+
+// the k nearest points to each of the nq queries, in parallel
+// (query q's lists are indices[q*k ... q*k+k-1] and d2s[q*k ... q*k+k-1]):
+static inline void KdNearestKBatch(const struct kdtree *t, const float *qx, const float *qy, int nq, int k, int *indices, float *d2s)
+{
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int q = 0; q < nq; q++)
+        KdNearestK(t, qx[q], qy[q], k, &indices[(size_t)q * k], &d2s[(size_t)q * k]);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+// The k-means pieces proj03 and proj03-sweep share, so the two make the same city copies and seed the same capitals:
+// the jittered copies of the data file, stride seeding and k-means++ seeding.
+//
+// The cities are passed as a pointer to the first longitude, a pointer to the first latitude and the stride
+// (in floats) from one city to the next: 1 for the structure of arrays, sizeof(struct city) / sizeof(float)
+// for proj03's array of structures. The number of capitals K is a run-time argument.
+
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "cities.h"
+
+#define SEEDBLOCK 4096 // k-means++ sums the weights in blocks this big, in this order, whatever the number of threads is
+
+// Re-entrant Random number generation function
+static inline float Ranf_r(unsigned int *seed, float low, float high)
+{
+    float r = (float)rand_r(seed); // 0 - RAND_MAX
+    float t = r / (float)RAND_MAX; // 0. - 1.
+
+    return low + t * (high - low);
+}
+
+// copies copies of the points, one after the other (copy 0 is exact, the others are jittered by up to
+// plus or minus jitter degrees so the clustering still has work to do):
+static inline void CopyCities(const struct points *points, int copies, float jitter,
+                              float *longitude, float *latitude, int stride)
+{
+    unsigned int seed = 0;
+    for (int c = 0; c < copies; c++)
+    {
+        for (int j = 0; j < points->num; j++)
+        {
+            size_t i = (size_t)(c * points->num + j) * stride;
+            float cityJitter = c == 0 ? 0. : jitter;
+            float dlong = Ranf_r(&seed, -cityJitter, cityJitter);
+            float dlat = Ranf_r(&seed, -cityJitter, cityJitter);
+            longitude[i] = points->longitude[j] + dlong;
+            latitude[i] = points->latitude[j] + dlat;
+        }
+    }
+}
+
+// pick the K capitals at uniform intervals through the first numFileCities cities (the data file):
+static inline void SeedStride(const float *longitude, const float *latitude, int stride, int numFileCities, int K,
+                              float *capitalLongitude, float *capitalLatitude)
+{
+    for (int k = 0; k < K; k++)
+    {
+        int cityIndex = K == 1 ? 0 : (int)((long)k * (numFileCities - 1) / (K - 1));
+        capitalLongitude[k] = longitude[(size_t)cityIndex * stride];
+        capitalLatitude[k] = latitude[(size_t)cityIndex * stride];
+    }
+}
+
+// lower every city's squared distance to its nearest capital so far, d2[i], for a new capital at (x, y):
+static inline void LowerDistances(const float *longitude, const float *latitude, int stride, int numCities,
+                                  float *d2, float x, float y, int numThreads)
+{
+#pragma omp parallel for num_threads(numThreads)
+    for (int i = 0; i < numCities; i++)
+    {
+        float dx = longitude[(size_t)i * stride] - x;
+        float dy = latitude[(size_t)i * stride] - y;
+        float dist2 = dx * dx + dy * dy;
+        if (dist2 < d2[i])
+            d2[i] = dist2;
+    }
+}
+
+// k-means++: the first capital is a random city, and each next one is a city picked with probability
+// proportional to its squared distance to the nearest capital so far
+// (d2 is numCities floats of scratch space; the sums are over SEEDBLOCK blocks in order, so any number of threads
+// picks the same capitals)
+static inline void SeedPlusPlus(const float *longitude, const float *latitude, int stride, int numCities, int K,
+                                unsigned int seed, float *d2, float *capitalLongitude, float *capitalLatitude,
+                                int numThreads)
+{
+    int numBlocks = (numCities + SEEDBLOCK - 1) / SEEDBLOCK;
+    double *blockSums = (double *)malloc(numBlocks * sizeof(double));
+
+    int first = rand_r(&seed) % numCities;
+    capitalLongitude[0] = longitude[(size_t)first * stride];
+    capitalLatitude[0] = latitude[(size_t)first * stride];
+#pragma omp parallel for num_threads(numThreads)
+    for (int i = 0; i < numCities; i++)
+        d2[i] = INFINITY;
+    LowerDistances(longitude, latitude, stride, numCities, d2, capitalLongitude[0], capitalLatitude[0], numThreads);
+
+    for (int k = 1; k < K; k++)
+    {
+#pragma omp parallel for num_threads(numThreads)
+        for (int b = 0; b < numBlocks; b++)
+        {
+            double sum = 0.;
+            int end = (b + 1) * SEEDBLOCK < numCities ? (b + 1) * SEEDBLOCK : numCities;
+            for (int i = b * SEEDBLOCK; i < end; i++)
+                sum += d2[i];
+            blockSums[b] = sum;
+        }
+        double total = 0.;
+        for (int b = 0; b < numBlocks; b++)
+            total += blockSums[b];
+
+        // walk the blocks, then the cities in the block, to the one the random number lands in:
+        double r = Ranf_r(&seed, 0., 1.) * total;
+        int b = 0;
+        while (b < numBlocks - 1 && r >= blockSums[b])
+            r -= blockSums[b++];
+        int end = (b + 1) * SEEDBLOCK < numCities ? (b + 1) * SEEDBLOCK : numCities;
+        int pick = end - 1;
+        for (int i = b * SEEDBLOCK; i < end; i++)
+        {
+            if (r < d2[i])
+            {
+                pick = i;
+                break;
+            }
+            r -= d2[i];
+        }
+
+        capitalLongitude[k] = longitude[(size_t)pick * stride];
+        capitalLatitude[k] = latitude[(size_t)pick * stride];
+        LowerDistances(longitude, latitude, stride, numCities, d2, capitalLongitude[k], capitalLatitude[k], numThreads);
+    }
+
+    free(blockSums);
+}
+
+#endif
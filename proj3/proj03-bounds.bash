@@ -0,0 +1,24 @@
+#!/bin/bash
+# triangle-inequality engines (output/output-hamerly.csv, output/output-elkan.csv) vs the brute-force loop (output/output.csv)
+# the last column of every line is the percentage of the city-capital distances that were skipped
+echo "capitals, engine, % distances skipped, time to solution, speedup over brute force"
+for n in 5 10 20 50 100 200 500
+do
+  brute=""
+  for engine in "" "HAMERLY" "ELKAN"
+  do
+    define=""
+    csv=output/output.csv
+    if [ -n "$engine" ]
+    then
+      define="-D$engine"
+      csv=output/output-$(echo $engine | tr A-Z a-z).csv
+    fi
+     g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n $define -o proj03-bounds -lm -fopenmp
+    ./proj03-bounds -c 100 2> /dev/null
+    line=$(tail -n 1 $csv)
+    time=$(echo "$line" | cut -d, -f6)
+    [ -z "$brute" ] && brute=$time
+    echo "$n, ${engine:-BRUTE}, $(echo "$line" | cut -d, -f7 | tr -d ' '), $(echo $time), $(awk "BEGIN { printf \"%.2f\", $brute / $time }")"
+  done
+done
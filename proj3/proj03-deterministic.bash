@@ -0,0 +1,27 @@
+#!/bin/bash
+# reproducible block-ordered double sums (output/output-deterministic.csv) vs the float per-thread partials (output/output.csv)
+# on a million cities: the throughput of both, and a fingerprint of every iteration's changed cities, inertia and
+# capital shift (every run's own profile file), which DETERMINISTIC keeps the same at every thread count
+# (the cities and the profiles are scratch files in a temporary directory, removed at the end)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+g++ -O3 proj03.cpp -DNUMT=4 -o proj03-deterministic -lm -fopenmp
+./proj03-deterministic -c 3000 -w $scratch/cities-1m.bin 2> /dev/null
+echo "threads, capitals, fast megaCityCapitals/sec, deterministic megaCityCapitals/sec, relative throughput, fast fingerprint, deterministic fingerprint"
+for n in 5 50 200
+do
+  for t in 1 2 4 8
+  do
+    profile=$scratch/profile-fast-$t-$n.csv
+    g++ -O3 proj03.cpp -DNUMT=$t -DNUMCAPITALS=$n -DPROFILEFILE="\"$profile\"" -o proj03-deterministic -lm -fopenmp
+    ./proj03-deterministic $scratch/cities-1m.bin 2> /dev/null
+    fast=$(tail -n 1 output/output.csv | cut -d, -f4 | tr -d ' ')
+    fastPrint=$(cut -d, -f6-8 $profile | md5sum | cut -c1-8)
+    profile=$scratch/profile-deterministic-$t-$n.csv
+    g++ -O3 proj03.cpp -DNUMT=$t -DNUMCAPITALS=$n -DDETERMINISTIC -DPROFILEFILE="\"$profile\"" -o proj03-deterministic -lm -fopenmp
+    ./proj03-deterministic $scratch/cities-1m.bin 2> /dev/null
+    deterministic=$(tail -n 1 output/output-deterministic.csv | cut -d, -f4 | tr -d ' ')
+    deterministicPrint=$(cut -d, -f6-8 $profile | md5sum | cut -c1-8)
+    echo "$t, $n, $fast, $deterministic, $(awk "BEGIN { printf \"%.2f\", $deterministic / $fast }"), $fastPrint, $deterministicPrint"
+  done
+done
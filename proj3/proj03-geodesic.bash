@@ -0,0 +1,24 @@
+#!/bin/bash
+# planar (output/output.csv) vs geodesic unit-vector (output/output-geodesic.csv) vs naive haversine (output/output-haversine.csv) clustering
+# the planar and geodesic inertias are in different units (degrees squared vs squared chords), so only the times compare
+echo "capitals, metric, iterations, time to solution, megaCityCapitals/sec, slowdown vs planar"
+for n in 5 10 20 50 100 200
+do
+  planar=""
+  for metric in "" "GEODESIC" "HAVERSINE"
+  do
+    define=""
+    csv=output/output.csv
+    if [ -n "$metric" ]
+    then
+      define="-D$metric"
+      csv=output/output-$(echo $metric | tr A-Z a-z).csv
+    fi
+     g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n $define -o proj03-geodesic -lm -fopenmp
+    ./proj03-geodesic -c 100 2> /dev/null
+    line=$(tail -n 1 $csv)
+    time=$(echo "$line" | cut -d, -f6)
+    [ -z "$planar" ] && planar=$time
+    echo "$n, ${metric:-PLANAR}, $(echo "$line" | cut -d, -f5 | tr -d ' '), $(echo $time), $(echo "$line" | cut -d, -f4 | tr -d ' '), $(awk "BEGIN { printf \"%.2f\", $time / $planar }")"
+  done
+done
@@ -0,0 +1,37 @@
+#!/bin/bash
+# warm start (-W, after a -S) vs cold start on a million cities after a 1% change: every 100th city deleted, as many inserted
+# (output/output.csv: the day-1 clustering, then the cold and the warm re-clustering of the changed cities;
+#  MAXITERATIONS is raised so day 1 converges and the state is worth starting from;
+#  the cities, the delta and the states are scratch files in a temporary directory, removed at the end)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+g++ -O3 proj03.cpp -DNUMT=4 -o proj03-incremental -lm -fopenmp
+./proj03-incremental -c 3000 -w $scratch/cities-1m.bin 2> /dev/null
+num=993000
+awk -F, -v num=$num 'NR > 1 { x[n] = $1; y[n] = $2; n++ }
+     END { srand(1); for (j = 0; j < num; j += 100) print "- " j;
+           for (c = 0; c < num / 100; c++) { r = int(n * rand()); printf "+ %.4f, %.4f\n", x[r] + rand() - 0.5, y[r] + rand() - 0.5 } }' UsCities.csv > $scratch/delta-1m.csv
+echo "capitals, engine, cold iterations, cold time, warm iterations, warm time, speedup, cold inertia, warm inertia"
+for n in 10 50 200
+do
+  for engine in "" "HAMERLY"
+  do
+    define=""
+    csv=output/output.csv
+    if [ -n "$engine" ]
+    then
+      define="-D$engine"
+      csv=output/output-$(echo $engine | tr A-Z a-z).csv
+    fi
+    g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n -DMAXITERATIONS=1000 $define -o proj03-incremental -lm -fopenmp
+    state=$scratch/state-$n-${engine:-BRUTE}.bin
+    ./proj03-incremental -S $state $scratch/cities-1m.bin 2> /dev/null
+    ./proj03-incremental -d $scratch/delta-1m.csv $scratch/cities-1m.bin 2> /dev/null
+    cold=$(tail -n 1 $csv)
+    ./proj03-incremental -d $scratch/delta-1m.csv -W $state $scratch/cities-1m.bin 2> /dev/null
+    warm=$(tail -n 1 $csv)
+    coldTime=$(echo "$cold" | cut -d, -f6 | tr -d ' ')
+    warmTime=$(echo "$warm" | cut -d, -f6 | tr -d ' ')
+    echo "$n, ${engine:-BRUTE}, $(echo "$cold" | cut -d, -f5 | tr -d ' '), $coldTime, $(echo "$warm" | cut -d, -f5 | tr -d ' '), $warmTime, $(awk "BEGIN { printf \"%.2f\", $coldTime / $warmTime }"), $(echo "$cold" | cut -d, -f9 | tr -d ' '), $(echo "$warm" | cut -d, -f9 | tr -d ' ')"
+  done
+done
@@ -0,0 +1,11 @@
+#!/bin/bash
+# k-d tree vs brute-force nearest-city lookups at 10^3 - 10^7 points (output/index.csv:
+# threads, points, lookups, brute sec, tree build sec, nearest sec, 8-nearest sec, speedup of build + nearest over brute)
+for t in 1 4
+do
+   g++ -O3 proj03-index.cpp -DNUMT=$t -o proj03-index -lm -fopenmp
+  for n in 1000 10000 100000 1000000 10000000
+  do
+    ./proj03-index $n
+  done
+done
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "kdtree.h"
+
+// k-d tree vs brute-force nearest-city lookup, the way proj03 names its capitals
+// usage: proj03-index [numpoints]
+
+// setting the number of threads:
+#ifndef NUMT
+#define NUMT 2
+#endif
+
+// how many lookups (capitals) to do:
+#ifndef NUMQUERIES
+#define NUMQUERIES 500
+#endif
+
+// how many neighbours the k-nearest lookups find:
+#ifndef KNN
+#define KNN 8
+#endif
+
+#define CSVFILE "output/index.csv"
+
+// Re-entrant Random number generation function
+float Ranf_r(unsigned int *seed, float low, float high)
+{
+    float r = (float)rand_r(seed); // 0 - RAND_MAX
+    float t = r / (float)RAND_MAX; // 0. - 1.
+
+    return low + t * (high - low);
+}
+
+int main(int argc, char *argv[])
+{
+    int numPoints = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (numPoints < KNN)
+    {
+        fprintf(stderr, "Usage: %s [numpoints]   (at least %d)\n", argv[0], KNN);
+        return 1;
+    }
+    omp_set_num_threads(NUMT);
+
+    // random points and queries over the continental US (the same longitude-latitude box as UsCities.csv):
+    float *x = new float[numPoints];
+    float *y = new float[numPoints];
+    unsigned int seed = 0;
+    for (int i = 0; i < numPoints; i++)
+    {
+        x[i] = Ranf_r(&seed, 67., 125.);
+        y[i] = Ranf_r(&seed, 25., 49.);
+    }
+    float qx[NUMQUERIES], qy[NUMQUERIES];
+    for (int q = 0; q < NUMQUERIES; q++)
+    {
+        qx[q] = Ranf_r(&seed, 67., 125.);
+        qy[q] = Ranf_r(&seed, 25., 49.);
+    }
+
+    // brute force, one query per iteration like the k-d tree batches:
+    int bruteNearest[NUMQUERIES];
+    double time0 = omp_get_wtime();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int q = 0; q < NUMQUERIES; q++)
+    {
+        float mind2 = INFINITY;
+        int mini = -1;
+        for (int i = 0; i < numPoints; i++)
+        {
+            float dx = qx[q] - x[i];
+            float dy = qy[q] - y[i];
+            float d2 = dx * dx + dy * dy;
+            if (d2 < mind2)
+            {
+                mind2 = d2;
+                mini = i;
+            }
+        }
+        bruteNearest[q] = mini;
+    }
+    double time1 = omp_get_wtime();
+
+    struct kdtree tree;
+    BuildKdTree(x, y, numPoints, &tree);
+    double time2 = omp_get_wtime();
+
+    int nearest[NUMQUERIES];
+    float nearestd2[NUMQUERIES];
+    KdNearestBatch(&tree, qx, qy, NUMQUERIES, nearest, nearestd2);
+    double time3 = omp_get_wtime();
+
+    int *knn = new int[NUMQUERIES * KNN];
+    float *knnd2 = new float[NUMQUERIES * KNN];
+    KdNearestKBatch(&tree, qx, qy, NUMQUERIES, KNN, knn, knnd2);
+    double time4 = omp_get_wtime();
+
+    // the tree has to find the same cities (and the k-nearest lists have to start with them):
+    int mismatches = 0;
+    for (int q = 0; q < NUMQUERIES; q++)
+    {
+        if (nearest[q] != bruteNearest[q] || knn[q * KNN] != bruteNearest[q])
+            mismatches++;
+    }
+    if (mismatches != 0)
+        fprintf(stderr, "%d of %d lookups found a different city than brute force!\n", mismatches, NUMQUERIES);
+
+    double bruteTime = time1 - time0;
+    double buildTime = time2 - time1;
+    double queryTime = time3 - time2;
+    double knnTime = time4 - time3;
+    fprintf(stderr, "%2d threads : %8d points ; %4d lookups ; brute = %10.6lf ; build = %10.6lf ; nearest = %10.6lf ; %d-nearest = %10.6lf sec ; speedup = %8.1lf\n",
+            NUMT, numPoints, NUMQUERIES, bruteTime, buildTime, queryTime, KNN, knnTime, bruteTime / (buildTime + queryTime));
+
+    FILE *file_pointer = fopen(CSVFILE, "a");
+    if (file_pointer == NULL)
+    {
+        fprintf(stderr, "Error opening CSV file!\n");
+        return 1;
+    }
+    fprintf(file_pointer, "%2d, %8d, %4d, %10.6lf, %10.6lf, %10.6lf, %10.6lf, %8.1lf\n",
+            NUMT, numPoints, NUMQUERIES, bruteTime, buildTime, queryTime, knnTime, bruteTime / (buildTime + queryTime));
+    fclose(file_pointer);
+
+    FreeKdTree(&tree);
+    delete[] x;
+    delete[] y;
+    delete[] knn;
+    delete[] knnd2;
+    return mismatches != 0;
+}
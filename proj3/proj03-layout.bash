@@ -0,0 +1,13 @@
+#!/bin/bash
+# structure-of-arrays vs array-of-structures city storage at large city counts
+# (output/output.csv vs output/output-aos.csv; the cache misses are printed too if perf is installed)
+PERF=""
+command -v perf > /dev/null && PERF="perf stat -e cache-references,cache-misses"
+for c in 1 10 100 1000 3000
+do
+  for layout in "" "-DAOS"
+  do
+     g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=20 $layout -o proj03-layout -lm -fopenmp
+    $PERF ./proj03-layout -c $c
+  done
+done
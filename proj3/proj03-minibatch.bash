@@ -0,0 +1,17 @@
+#!/bin/bash
+# mini-batch k-means streamed from a 10-million-city binary file vs full-batch k-means for the same wall-clock time
+# (output/minibatch.csv: threads, cities, capitals, batch size, seconds, batches, megaCities/sec, inertia,
+#  full-batch iterations, full-batch inertia, % gap of the mini-batch inertia over the full-batch one)
+# (the cities are a scratch file in a temporary directory, removed at the end)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+ g++ -O3 proj03.cpp -DNUMT=4 -o proj03-minibatch -lm -fopenmp
+./proj03-minibatch -c 30000 -w $scratch/cities-10m.bin 2> /dev/null
+ g++ -O3 proj03-minibatch.cpp -o proj03-minibatch -lm -fopenmp
+for T in 0.25 0.5 1 2 4
+do
+  for b in 4096 65536 1048576
+  do
+    ./proj03-minibatch -t 4 -k 20 -b $b -T $T -f $scratch/cities-10m.bin
+  done
+done
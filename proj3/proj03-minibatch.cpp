@@ -0,0 +1,320 @@
+#include <stdio.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+
+#include "cities.h"
+#include "kmeans.h"
+
+// Mini-batch k-means for proj03, for point sets bigger than memory:
+// the binary point file (proj03 -w makes one) is streamed through a batch at a time, over and over,
+// until the time budget runs out. Each batch is assigned to the nearest capitals in parallel (per-thread
+// partial sums, like proj03), then every capital moves toward the mean of its batch cities with its own learning
+// rate: (cities it got in this batch) / (cities it has ever got), so it settles down as it sees more of the data.
+// With -f the same capitals are also run as full-batch k-means (all the points in memory) for the same
+// wall-clock time, and the two are compared by their inertia over all the points.
+
+// setting the default number of threads (-t changes it):
+#ifndef NUMT
+#define NUMT 2
+#endif
+
+#define NUMCAPITALS 20  // -k changes it
+#define BATCHSIZE 65536 // -b changes it
+#define SECONDS 1.0     // the time budget, -T changes it
+
+// converged once no city changes capital, or no capital moves more than this (degrees):
+#ifndef TOLERANCE
+#define TOLERANCE 1.e-4
+#endif
+
+#define CSVFILE "output/minibatch.csv"
+
+int NumThreads = NUMT;
+int NumCapitals = NUMCAPITALS;
+
+float *CapitalLongitude;
+float *CapitalLatitude;
+double *CapitalSeen; // how many cities each capital has been given so far (mini-batch learning rates)
+
+// each thread's private partial sums
+// (aligned to a cache line so two threads never write into the same line):
+struct partial
+{
+    double *longsum;
+    double *latsum;
+    int *numsum;
+    double inertia;
+} __attribute__((aligned(64)));
+
+struct partial *Partials;
+
+// assign n cities to their nearest capitals, summing them into the per-thread partials, then merge those
+// into sums[] and counts[]; returns the inertia
+double AssignBatch(const float *longitude, const float *latitude, int n, double *longSums, double *latSums, int *counts)
+{
+#pragma omp parallel
+    {
+        struct partial *p = &Partials[omp_get_thread_num()];
+        for (int k = 0; k < NumCapitals; k++)
+        {
+            p->longsum[k] = p->latsum[k] = 0.;
+            p->numsum[k] = 0;
+        }
+        p->inertia = 0.;
+
+#pragma omp for
+        for (int i = 0; i < n; i++)
+        {
+            float best = INFINITY;
+            int bestk = 0;
+            for (int k = 0; k < NumCapitals; k++)
+            {
+                float dx = longitude[i] - CapitalLongitude[k];
+                float dy = latitude[i] - CapitalLatitude[k];
+                float d2 = dx * dx + dy * dy;
+                if (d2 < best)
+                {
+                    best = d2;
+                    bestk = k;
+                }
+            }
+            p->longsum[bestk] += longitude[i];
+            p->latsum[bestk] += latitude[i];
+            p->numsum[bestk]++;
+            p->inertia += best;
+        }
+    }
+
+    double inertia = 0.;
+    for (int k = 0; k < NumCapitals; k++)
+    {
+        longSums[k] = latSums[k] = 0.;
+        counts[k] = 0;
+    }
+    for (int t = 0; t < NumThreads; t++)
+    {
+        for (int k = 0; k < NumCapitals; k++)
+        {
+            longSums[k] += Partials[t].longsum[k];
+            latSums[k] += Partials[t].latsum[k];
+            counts[k] += Partials[t].numsum[k];
+        }
+        inertia += Partials[t].inertia;
+    }
+    return inertia;
+}
+
+// the inertia of the capitals over the whole file, streamed through in batches:
+double StreamedInertia(struct pointstream *ps, float *longitude, float *latitude, int batchSize,
+                       double *longSums, double *latSums, int *counts)
+{
+    double inertia = 0.;
+    for (int start = 0; start < ps->num; start += batchSize)
+    {
+        int n = ReadPointBatch(ps, start, batchSize, longitude, latitude);
+        inertia += AssignBatch(longitude, latitude, n, longSums, latSums, counts);
+    }
+    return inertia;
+}
+
+void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-k capitals] [-t threads] [-b batch] [-T seconds] [-r seed] [-f] cities.bin\n", prog);
+    fprintf(stderr, "\t-k capitals  how many capitals (default %d)\n", NUMCAPITALS);
+    fprintf(stderr, "\t-t threads   how many threads (default %d)\n", NUMT);
+    fprintf(stderr, "\t-b batch     cities per mini-batch (default %d)\n", BATCHSIZE);
+    fprintf(stderr, "\t-T seconds   the time budget (default %.1lf)\n", SECONDS);
+    fprintf(stderr, "\t-r seed      the k-means++ random number seed (default 0)\n");
+    fprintf(stderr, "\t-f           also run full-batch k-means from the same capitals for the same time and compare\n");
+    fprintf(stderr, "\tcities.bin   a binary point file (proj03 -w makes one)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int batchSize = BATCHSIZE;
+    double budget = SECONDS;
+    unsigned int seed = 0;
+    bool compare = false;
+    const char *dataFile = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            NumCapitals = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            NumThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            batchSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+            budget = atof(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            seed = (unsigned int)atol(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0)
+            compare = true;
+        else if (argv[i][0] != '-' && dataFile == NULL)
+            dataFile = argv[i];
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (dataFile == NULL || NumCapitals < 1 || NumThreads < 1 || batchSize < NumCapitals || budget <= 0.)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    omp_set_num_threads(NumThreads);
+
+    struct pointstream ps;
+    if (!OpenPointStream(dataFile, &ps))
+        return 1;
+    if (ps.num < NumCapitals)
+    {
+        fprintf(stderr, "'%s' has only %d cities\n", dataFile, ps.num);
+        ClosePointStream(&ps);
+        return 1;
+    }
+    if (batchSize > ps.num)
+        batchSize = ps.num;
+
+    // only one batch and the capitals are ever in memory:
+    float *longitude = (float *)AllocAligned(batchSize * sizeof(float));
+    float *latitude = (float *)AllocAligned(batchSize * sizeof(float));
+    CapitalLongitude = new float[NumCapitals];
+    CapitalLatitude = new float[NumCapitals];
+    CapitalSeen = new double[NumCapitals]();
+    double *longSums = new double[NumCapitals];
+    double *latSums = new double[NumCapitals];
+    int *counts = new int[NumCapitals];
+    float *startLongitude = new float[NumCapitals];
+    float *startLatitude = new float[NumCapitals];
+    Partials = (struct partial *)AllocAligned(NumThreads * sizeof(struct partial));
+    for (int t = 0; t < NumThreads; t++)
+    {
+        Partials[t].longsum = new double[NumCapitals];
+        Partials[t].latsum = new double[NumCapitals];
+        Partials[t].numsum = new int[NumCapitals];
+    }
+
+    // k-means++ over the first batch (kmeans.h's, so the same -r picks the same capitals with any -t):
+    int n = ReadPointBatch(&ps, 0, batchSize, longitude, latitude);
+    if (n < NumCapitals)
+    {
+        fprintf(stderr, "Cannot read the first %d cities of '%s'\n", batchSize, dataFile);
+        ClosePointStream(&ps);
+        return 1;
+    }
+    float *d2 = (float *)AllocAligned(n * sizeof(float));
+    SeedPlusPlus(longitude, latitude, 1, n, NumCapitals, seed, d2, CapitalLongitude, CapitalLatitude, NumThreads);
+    free(d2);
+    memcpy(startLongitude, CapitalLongitude, NumCapitals * sizeof(float));
+    memcpy(startLatitude, CapitalLatitude, NumCapitals * sizeof(float));
+
+    // mini-batches, wrapping around the file, until the time runs out:
+    long numPoints = 0;
+    int numBatches = 0;
+    int start = 0;
+    double time0 = omp_get_wtime();
+    double elapsed = 0.;
+    while (elapsed < budget)
+    {
+        n = ReadPointBatch(&ps, start, batchSize, longitude, latitude);
+        start = start + n < ps.num ? start + n : 0;
+        AssignBatch(longitude, latitude, n, longSums, latSums, counts);
+
+        // every capital moves toward its batch mean, by (batch count) / (total count so far):
+        for (int k = 0; k < NumCapitals; k++)
+        {
+            if (counts[k] == 0)
+                continue;
+            CapitalSeen[k] += counts[k];
+            float eta = counts[k] / CapitalSeen[k];
+            CapitalLongitude[k] += eta * ((float)(longSums[k] / counts[k]) - CapitalLongitude[k]);
+            CapitalLatitude[k] += eta * ((float)(latSums[k] / counts[k]) - CapitalLatitude[k]);
+        }
+
+        numPoints += n;
+        numBatches++;
+        elapsed = omp_get_wtime() - time0;
+    }
+    double pointsPerSecond = (double)numPoints / elapsed;
+
+    // how good it is, over all the points (not timed):
+    double inertia = StreamedInertia(&ps, longitude, latitude, batchSize, longSums, latSums, counts);
+    fprintf(stderr, "%2d threads : %d cities ; %d capitals ; %d batches of %d in %.3lf sec = %.3lf megaCities/sec ; inertia = %.4lf\n",
+            NumThreads, ps.num, NumCapitals, numBatches, batchSize, elapsed, pointsPerSecond / 1000000., inertia);
+
+    // full-batch k-means from the same capitals, for the same time (this one needs all the points in memory):
+    int fullIterations = 0;
+    double fullInertia = 0., gapPercent = 0.;
+    if (compare)
+    {
+        struct points points;
+        if (!LoadPoints(dataFile, NumThreads, &points))
+            return 1;
+        memcpy(CapitalLongitude, startLongitude, NumCapitals * sizeof(float));
+        memcpy(CapitalLatitude, startLatitude, NumCapitals * sizeof(float));
+
+        double time1 = omp_get_wtime();
+        while (omp_get_wtime() - time1 < budget)
+        {
+            AssignBatch(points.longitude, points.latitude, points.num, longSums, latSums, counts);
+            fullIterations++;
+            float maxShift = 0.;
+            for (int k = 0; k < NumCapitals; k++)
+            {
+                if (counts[k] == 0) // nobody likes this capital, leave it where it is
+                    continue;
+                float lng = longSums[k] / counts[k];
+                float lat = latSums[k] / counts[k];
+                maxShift = fmaxf(maxShift, sqrtf((lng - CapitalLongitude[k]) * (lng - CapitalLongitude[k]) +
+                                                 (lat - CapitalLatitude[k]) * (lat - CapitalLatitude[k])));
+                CapitalLongitude[k] = lng;
+                CapitalLatitude[k] = lat;
+            }
+            if (maxShift < TOLERANCE)
+                break;
+        }
+        double fullTime = omp_get_wtime() - time1;
+        fullInertia = AssignBatch(points.longitude, points.latitude, points.num, longSums, latSums, counts);
+        gapPercent = 100. * (inertia - fullInertia) / fullInertia;
+        fprintf(stderr, "full batch : %d iterations in %.3lf sec ; inertia = %.4lf ; mini-batch gap = %+.2lf%%\n",
+                fullIterations, fullTime, fullInertia, gapPercent);
+        FreePoints(&points);
+    }
+
+    FILE *fp = fopen(CSVFILE, "a");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening CSV file!\n");
+        return 1;
+    }
+    fprintf(fp, "%2d, %8d, %4d, %6d, %8.3lf, %6d, %10.3lf, %14.4lf, %3d, %14.4lf, %8.3lf\n", NumThreads, ps.num, NumCapitals,
+            batchSize, elapsed, numBatches, pointsPerSecond / 1000000., inertia, fullIterations, fullInertia, gapPercent);
+    fclose(fp);
+
+    for (int t = 0; t < NumThreads; t++)
+    {
+        delete[] Partials[t].longsum;
+        delete[] Partials[t].latsum;
+        delete[] Partials[t].numsum;
+    }
+    free(Partials);
+    free(longitude);
+    free(latitude);
+    delete[] CapitalLongitude;
+    delete[] CapitalLatitude;
+    delete[] CapitalSeen;
+    delete[] longSums;
+    delete[] latSums;
+    delete[] counts;
+    delete[] startLongitude;
+    delete[] startLatitude;
+    ClosePointStream(&ps);
+    return 0;
+}
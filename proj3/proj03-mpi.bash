@@ -0,0 +1,17 @@
+#!/bin/bash
+# distributed k-means on a million cities: 1-8 MPI ranks on this machine x 1-4 OpenMP threads per rank
+# (output/mpi.csv: ranks, threads, cities, capitals, iterations, seconds, megaCityCapitals/sec,
+#  seconds in the slowest rank's MPI_Allreduce, inertia)
+# (the cities are a scratch file in a temporary directory, removed at the end)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+g++ -O3 proj03.cpp -DNUMT=4 -o proj03-mpi -lm -fopenmp
+./proj03-mpi -c 3000 -w $scratch/cities-1m.bin 2> /dev/null
+mpic++ -O3 proj03-mpi.cpp -o proj03-mpi -lm -fopenmp
+for b in 1 2 4 6 8
+do
+  for t in 1 2 4
+  do
+    mpirun --oversubscribe -np $b ./proj03-mpi -t $t -k 50 $scratch/cities-1m.bin
+  done
+done
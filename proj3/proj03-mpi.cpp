@@ -0,0 +1,302 @@
+#include <stdio.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <mpi.h>
+
+#include "cities.h"
+
+// Distributed k-means for proj03, for point sets too big for one node (the way proj7 spreads its signal):
+// every rank reads only its own shard of the binary point file (proj03 -w makes one), assigns it to the nearest
+// capitals with its OpenMP threads and per-thread partial sums, and then one MPI_Allreduce per iteration adds up
+// every rank's sums, counts, changed cities and inertia. Each rank then computes the same new capitals from the
+// same global sums, so they all agree on them, and on when to stop, without any more messages.
+// The capitals are seeded the way proj03 does by default: cities at uniform intervals through the whole file.
+
+// which node is in charge (of printing and writing the CSV file)?
+#define THEBOSS 0
+
+// setting the default number of threads per rank (-t changes it):
+#ifndef NUMT
+#define NUMT 2
+#endif
+
+#define NUMCAPITALS 50 // -k changes it
+
+// maximum iterations to allow looking for convergence:
+#ifndef MAXITERATIONS
+#define MAXITERATIONS 100
+#endif
+
+// converged once no city changes capital, or no capital moves more than this (degrees):
+#ifndef TOLERANCE
+#define TOLERANCE 1.e-4
+#endif
+
+#define CSVFILE "output/mpi.csv"
+
+int NumThreads = NUMT;
+int NumCapitals = NUMCAPITALS;
+int NumCpus; // total # of ranks involved
+int Me;      // which one I am
+
+float *CapitalLongitude;
+float *CapitalLatitude;
+
+// this rank's shard of the cities:
+int PPSize;
+float *PPLongitude;
+float *PPLatitude;
+int *PPCapital;
+
+// each thread's private partial sums
+// (aligned to a cache line so two threads never write into the same line):
+struct partial
+{
+    double *longsum;
+    double *latsum;
+    double *numsum;
+    int changed;
+    double inertia;
+} __attribute__((aligned(64)));
+
+struct partial *Partials;
+
+// assign this rank's cities to their nearest capitals, and put the rank's sums into sums[ ]:
+// longitude sums [0,K), latitude sums [K,2K), city counts [2K,3K), then changed cities and inertia
+void AssignShard(double *sums)
+{
+#pragma omp parallel
+    {
+        struct partial *p = &Partials[omp_get_thread_num()];
+        for (int k = 0; k < NumCapitals; k++)
+            p->longsum[k] = p->latsum[k] = p->numsum[k] = 0.;
+        p->changed = 0;
+        p->inertia = 0.;
+
+#pragma omp for
+        for (int i = 0; i < PPSize; i++)
+        {
+            float best = INFINITY;
+            int bestk = 0;
+            for (int k = 0; k < NumCapitals; k++)
+            {
+                float dx = PPLongitude[i] - CapitalLongitude[k];
+                float dy = PPLatitude[i] - CapitalLatitude[k];
+                float d2 = dx * dx + dy * dy;
+                if (d2 < best)
+                {
+                    best = d2;
+                    bestk = k;
+                }
+            }
+            if (PPCapital[i] != bestk)
+                p->changed++;
+            PPCapital[i] = bestk;
+            p->longsum[bestk] += PPLongitude[i];
+            p->latsum[bestk] += PPLatitude[i];
+            p->numsum[bestk] += 1.;
+            p->inertia += best;
+        }
+    }
+
+    memset(sums, 0, (3 * NumCapitals + 2) * sizeof(double));
+    for (int t = 0; t < NumThreads; t++)
+    {
+        for (int k = 0; k < NumCapitals; k++)
+        {
+            sums[k] += Partials[t].longsum[k];
+            sums[NumCapitals + k] += Partials[t].latsum[k];
+            sums[2 * NumCapitals + k] += Partials[t].numsum[k];
+        }
+        sums[3 * NumCapitals] += Partials[t].changed;
+        sums[3 * NumCapitals + 1] += Partials[t].inertia;
+    }
+}
+
+void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun -np ranks %s [-k capitals] [-t threads] cities.bin\n", prog);
+    fprintf(stderr, "\t-k capitals  how many capitals (default %d)\n", NUMCAPITALS);
+    fprintf(stderr, "\t-t threads   how many threads per rank (default %d)\n", NUMT);
+    fprintf(stderr, "\tcities.bin   a binary point file (proj03 -w makes one)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+
+    MPI_Comm_size(MPI_COMM_WORLD, &NumCpus);
+    MPI_Comm_rank(MPI_COMM_WORLD, &Me);
+
+    const char *dataFile = NULL;
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            NumCapitals = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            NumThreads = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && dataFile == NULL)
+            dataFile = argv[i];
+        else
+            ok = false;
+    }
+    if (!ok || dataFile == NULL || NumCapitals < 1 || NumThreads < 1)
+    {
+        if (Me == THEBOSS)
+            Usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+    omp_set_num_threads(NumThreads);
+
+    // every rank reads just its own shard of the file:
+    struct pointstream ps = {};
+    bool opened = OpenPointStream(dataFile, &ps);
+    ok = opened && ps.num >= NumCapitals;
+    int first = 0;
+    double time0 = MPI_Wtime();
+    if (opened && !ok)
+        ClosePointStream(&ps);
+    if (ok)
+    {
+        first = (int)((long)ps.num * Me / NumCpus);
+        int last = (int)((long)ps.num * (Me + 1) / NumCpus);
+        PPSize = last - first;
+        PPLongitude = (float *)AllocAligned(PaddedCount(PPSize) * sizeof(float));
+        PPLatitude = (float *)AllocAligned(PaddedCount(PPSize) * sizeof(float));
+        PPCapital = new int[PPSize];
+        ok = ReadPointBatch(&ps, first, PPSize, PPLongitude, PPLatitude) == PPSize || PPSize == 0;
+        ClosePointStream(&ps);
+    }
+    int allOk;
+    int mine = ok;
+    MPI_Allreduce(&mine, &allOk, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!allOk)
+    {
+        if (Me == THEBOSS)
+            fprintf(stderr, "Cannot read %d shards of %d capitals' worth of cities from '%s'\n", NumCpus, NumCapitals, dataFile);
+        MPI_Finalize();
+        return 1;
+    }
+    double loadTime = MPI_Wtime() - time0;
+    int numCities = ps.num;
+    for (int i = 0; i < PPSize; i++)
+        PPCapital[i] = -1;
+
+    CapitalLongitude = new float[NumCapitals];
+    CapitalLatitude = new float[NumCapitals];
+    double *sums = new double[3 * NumCapitals + 2];
+    double *globalSums = new double[3 * NumCapitals + 2];
+    Partials = (struct partial *)AllocAligned(NumThreads * sizeof(struct partial));
+    for (int t = 0; t < NumThreads; t++)
+    {
+        Partials[t].longsum = new double[NumCapitals];
+        Partials[t].latsum = new double[NumCapitals];
+        Partials[t].numsum = new double[NumCapitals];
+    }
+
+    // seed the capitals at uniform intervals through the whole file: the rank that has the city contributes it
+    // (everyone else adds zeros):
+    for (int k = 0; k < 2 * NumCapitals; k++)
+        sums[k] = 0.;
+    for (int k = 0; k < NumCapitals; k++)
+    {
+        int cityIndex = NumCapitals == 1 ? 0 : (int)((long)k * (numCities - 1) / (NumCapitals - 1));
+        if (cityIndex >= first && cityIndex < first + PPSize)
+        {
+            sums[k] = PPLongitude[cityIndex - first];
+            sums[NumCapitals + k] = PPLatitude[cityIndex - first];
+        }
+    }
+    MPI_Allreduce(sums, globalSums, 2 * NumCapitals, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    for (int k = 0; k < NumCapitals; k++)
+    {
+        CapitalLongitude[k] = (float)globalSums[k];
+        CapitalLatitude[k] = (float)globalSums[NumCapitals + k];
+    }
+
+    // the iterations, one MPI_Allreduce each:
+    MPI_Barrier(MPI_COMM_WORLD);
+    double solveTime0 = MPI_Wtime();
+    double reduceTime = 0.; // time spent in (and waiting at) the MPI_Allreduce
+    int iterations = 0;
+    double inertia = 0.;
+    for (int n = 0; n < MAXITERATIONS; n++)
+    {
+        AssignShard(sums);
+
+        double reduce0 = MPI_Wtime();
+        MPI_Allreduce(sums, globalSums, 3 * NumCapitals + 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        reduceTime += MPI_Wtime() - reduce0;
+        iterations++;
+
+        // every rank does the same arithmetic on the same sums, so every rank gets the same capitals:
+        float maxShift = 0.;
+        for (int k = 0; k < NumCapitals; k++)
+        {
+            double count = globalSums[2 * NumCapitals + k];
+            if (count == 0.) // nobody likes this capital, leave it where it is
+                continue;
+            float longitude = (float)(globalSums[k] / count);
+            float latitude = (float)(globalSums[NumCapitals + k] / count);
+            float dx = longitude - CapitalLongitude[k];
+            float dy = latitude - CapitalLatitude[k];
+            maxShift = fmaxf(maxShift, sqrtf(dx * dx + dy * dy));
+            CapitalLongitude[k] = longitude;
+            CapitalLatitude[k] = latitude;
+        }
+        long changed = (long)globalSums[3 * NumCapitals];
+        inertia = globalSums[3 * NumCapitals + 1];
+
+        if (changed == 0 || maxShift < TOLERANCE)
+            break;
+    }
+    double timeToSolution = MPI_Wtime() - solveTime0;
+
+    // the slowest rank's communication time is the one that counts:
+    double maxReduceTime;
+    MPI_Reduce(&reduceTime, &maxReduceTime, 1, MPI_DOUBLE, MPI_MAX, THEBOSS, MPI_COMM_WORLD);
+
+    if (Me == THEBOSS)
+    {
+        double megaCityCapitalsPerSecond = (double)numCities * (double)NumCapitals * (double)iterations / timeToSolution / 1000000.;
+        fprintf(stderr, "%2d ranks x %2d threads : %d cities ; %d capitals ; loaded in %.4lf sec ; %3d iterations in %10.6lf sec = %9.2lf megaCityCapitals/sec ; allreduce = %.1lf%% ; inertia = %.4lf\n",
+                NumCpus, NumThreads, numCities, NumCapitals, loadTime, iterations, timeToSolution, megaCityCapitalsPerSecond,
+                100. * maxReduceTime / timeToSolution, inertia);
+
+        FILE *fp = fopen(CSVFILE, "a");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Error opening CSV file!\n");
+        }
+        else
+        {
+            fprintf(fp, "%2d, %2d, %8d, %4d, %3d, %10.6lf, %9.2lf, %10.6lf, %14.4lf\n", NumCpus, NumThreads, numCities,
+                    NumCapitals, iterations, timeToSolution, megaCityCapitalsPerSecond, maxReduceTime, inertia);
+            fclose(fp);
+        }
+    }
+
+    for (int t = 0; t < NumThreads; t++)
+    {
+        delete[] Partials[t].longsum;
+        delete[] Partials[t].latsum;
+        delete[] Partials[t].numsum;
+    }
+    free(Partials);
+    free(PPLongitude);
+    free(PPLatitude);
+    delete[] PPCapital;
+    delete[] CapitalLongitude;
+    delete[] CapitalLatitude;
+    delete[] sums;
+    delete[] globalSums;
+
+    // all done:
+    MPI_Finalize();
+    return 0;
+}
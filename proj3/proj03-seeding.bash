@@ -0,0 +1,19 @@
+#!/bin/bash
+# index-stride vs k-means++ vs k-means|| seeding: iterations to convergence and final inertia
+# (the random seedings are averaged over 5 seeds; every run also appends its line to output/output.csv)
+echo "capitals, seeding, iterations, final inertia, seeding sec"
+for n in 5 10 20 50 100 200 500
+do
+   g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n -o proj03-seeding -lm -fopenmp
+  for seeding in stride plusplus parallel
+  do
+    seeds="0 1 2 3 4"
+    [ $seeding = stride ] && seeds="0"
+    for r in $seeds
+    do
+      ./proj03-seeding -c 100 -i $seeding -r $r 2> /dev/null
+      tail -n 1 output/output.csv
+    done | awk -F, -v n=$n -v s=$seeding '{ it += $5; inertia += $9; sec += $8 }
+        END { printf "%d, %s, %.1f, %.4f, %.6f\n", n, s, it / NR, inertia / NR, sec / NR }'
+  done
+done
@@ -0,0 +1,13 @@
+#!/bin/bash
+# SIMD squared-distance kernel (output/output.csv) vs the scalar sqrtf loop (output/output-scalar.csv)
+# over the same capital sweep as proj03.bash
+for t in 1 4
+do
+  for n in 2 3 4 5 10 15 20 30 40 50
+  do
+     g++ -O3 -march=native proj03.cpp -DNUMT=$t -DNUMCAPITALS=$n -o proj03-simd -lm -fopenmp
+    ./proj03-simd -c 100
+     g++ -O3 -march=native proj03.cpp -DNUMT=$t -DNUMCAPITALS=$n -DSCALAR -o proj03-simd -lm -fopenmp
+    ./proj03-simd -c 100
+  done
+done
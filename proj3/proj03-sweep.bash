@@ -0,0 +1,17 @@
+#!/bin/bash
+# the same capitals x threads sweep as proj03.bash, but compiled once and run as one process per thread count
+# (output/sweep.csv: threads, cities, capitals, iterations, seconds, megaCityCapitals/sec, inertia, silhouette, ...)
+ g++ -O3 proj03-sweep.cpp -o proj03-sweep -lm -fopenmp
+for t in 1 2 4 6 8 12 16
+do
+  ./proj03-sweep -t $t -k 2:50 "$@"
+done
+# 8 k-means++ restarts per K, concurrent vs sequential vs the automatic choice, small and large city counts
+# (sweep.csv lines then also have: restarts, concurrent?, mean inertia, worst inertia, seconds per restart)
+for c in 1 100
+do
+  for m in concurrent sequential auto
+  do
+    ./proj03-sweep -t 8 -k 5:50:5 -R 8 -m $m -c $c "$@"
+  done
+done
@@ -0,0 +1,579 @@
+#include <stdio.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+
+#include "cities.h"
+#include "kmeans.h"
+
+// Sweep of the number of capitals for proj03, in one process:
+// the cities are loaded once, and every K in the range is clustered in turn (every one with all the threads),
+// reusing the same arrays. For every K the inertia and a silhouette score over a sample of the cities are
+// computed, and at the end an "elbow" K is recommended (the K where the inertia curve bends the most).
+// The copies and the seeding are kmeans.h's, the same as proj03's, so every K gives the same capitals as proj03
+// compiled with -DNUMCAPITALS=K and run with the same -i and -r.
+//
+// With -R restarts, every K is clustered that many times from different k-means++ seeds and the lowest-inertia
+// solution is kept. Small problems run the restarts concurrently, each one on its own group of threads
+// (a parallel region per iteration costs more than the iteration itself there); big ones run them one after the
+// other, each with all the threads.
+
+// setting the default number of threads (-t changes it):
+#ifndef NUMT
+#define NUMT 2
+#endif
+
+// maximum iterations to allow looking for convergence:
+#define MAXITERATIONS 100
+
+// converged once no city changes capital, or no capital moves more than this (degrees):
+#ifndef TOLERANCE
+#define TOLERANCE 1.e-4
+#endif
+
+#define DATAFILE "UsCities.csv"
+#define CITYJITTER 0.5 // degrees, plus or minus, for the extra copies made with -c
+
+#define SAMPLES 2000  // the silhouette is computed over this many cities (-s changes it)
+#define CITYBLOCK 16  // the assignment does this many cities at once, one per SIMD lane
+
+// restarts run concurrently when one iteration is less than this many city-capital distances per thread:
+#define CONCURRENTWORK 200000
+
+#define CSVFILE "output/sweep.csv"
+
+// the cities, as structure of arrays:
+int NumCities;
+float *CityLongitude;
+float *CityLatitude;
+
+// the most capitals in the sweep:
+int MaxCapitals;
+
+// each thread's private partial sums
+// (aligned to a cache line so two threads never write into the same line):
+struct partial
+{
+    float *longsum;
+    float *latsum;
+    int *numsum;
+    double *distsum; // the silhouette's distance sums
+    int changed;
+    double inertia;
+} __attribute__((aligned(64)));
+
+// everything one k-means run needs, allocated once for the biggest K (and the most threads) and reused:
+struct run
+{
+    int numThreads; // how many threads this run's parallel loops use
+    float *capitalLongitude;
+    float *capitalLatitude;
+    float *capitalLongSum;
+    float *capitalLatSum;
+    int *capitalNumSum;
+    int *cityCapital;
+    float *cityDistance2;     // k-means++: each city's squared distance to the nearest capital so far
+    struct partial *partials; // one per thread
+    float *bestLongitude;     // the capitals of the best restart this run has done
+    float *bestLatitude;
+    double bestInertia;
+    int bestIterations;
+    long iterations; // of all the restarts this run has done
+};
+
+int NumThreads = NUMT;
+
+// what we remember about each K:
+struct result
+{
+    int k;
+    int iterations; // of the best restart
+    long allIterations; // of all the restarts, for the throughput
+    double seconds;
+    double inertia; // the best one
+    double meanInertia;
+    double worstInertia;
+    double silhouette;
+    bool concurrent;
+};
+
+void AllocRun(struct run *r, int maxThreads)
+{
+    r->numThreads = maxThreads;
+    r->capitalLongitude = new float[MaxCapitals];
+    r->capitalLatitude = new float[MaxCapitals];
+    r->capitalLongSum = new float[MaxCapitals];
+    r->capitalLatSum = new float[MaxCapitals];
+    r->capitalNumSum = new int[MaxCapitals];
+    r->cityCapital = (int *)AllocAligned(NumCities * sizeof(int));
+    r->cityDistance2 = (float *)AllocAligned(NumCities * sizeof(float));
+    r->partials = (struct partial *)AllocAligned(maxThreads * sizeof(struct partial));
+    for (int t = 0; t < maxThreads; t++)
+    {
+        r->partials[t].longsum = new float[MaxCapitals];
+        r->partials[t].latsum = new float[MaxCapitals];
+        r->partials[t].numsum = new int[MaxCapitals];
+        r->partials[t].distsum = new double[MaxCapitals];
+    }
+    r->bestLongitude = new float[MaxCapitals];
+    r->bestLatitude = new float[MaxCapitals];
+}
+
+void FreeRun(struct run *r, int maxThreads)
+{
+    for (int t = 0; t < maxThreads; t++)
+    {
+        delete[] r->partials[t].longsum;
+        delete[] r->partials[t].latsum;
+        delete[] r->partials[t].numsum;
+        delete[] r->partials[t].distsum;
+    }
+    free(r->partials);
+    delete[] r->capitalLongitude;
+    delete[] r->capitalLatitude;
+    delete[] r->capitalLongSum;
+    delete[] r->capitalLatSum;
+    delete[] r->capitalNumSum;
+    free(r->cityCapital);
+    free(r->cityDistance2);
+    delete[] r->bestLongitude;
+    delete[] r->bestLatitude;
+}
+
+// every city to its nearest capital, summing the capitals' new centres in the per-thread partials;
+// returns how many cities changed capital (and the inertia)
+int Assign(struct run *r, int K, double *inertia)
+{
+#pragma omp parallel num_threads(r->numThreads)
+    {
+        struct partial *p = &r->partials[omp_get_thread_num()];
+        for (int k = 0; k < K; k++)
+        {
+            p->longsum[k] = 0.;
+            p->latsum[k] = 0.;
+            p->numsum[k] = 0;
+        }
+        p->changed = 0;
+        p->inertia = 0.;
+
+#pragma omp for
+        for (int i0 = 0; i0 < NumCities; i0 += CITYBLOCK)
+        {
+            // one city per lane, all the capitals in turn:
+            int n = NumCities - i0 < CITYBLOCK ? NumCities - i0 : CITYBLOCK;
+            float x[CITYBLOCK], y[CITYBLOCK], best[CITYBLOCK];
+            int bestk[CITYBLOCK];
+            for (int j = 0; j < CITYBLOCK; j++)
+            {
+                x[j] = j < n ? CityLongitude[i0 + j] : 0.;
+                y[j] = j < n ? CityLatitude[i0 + j] : 0.;
+                best[j] = INFINITY;
+                bestk[j] = -1;
+            }
+            for (int k = 0; k < K; k++)
+            {
+                float cx = r->capitalLongitude[k];
+                float cy = r->capitalLatitude[k];
+#pragma omp simd
+                for (int j = 0; j < CITYBLOCK; j++)
+                {
+                    float dx = x[j] - cx;
+                    float dy = y[j] - cy;
+                    float d2 = dx * dx + dy * dy;
+                    bestk[j] = d2 < best[j] ? k : bestk[j];
+                    best[j] = d2 < best[j] ? d2 : best[j];
+                }
+            }
+
+            for (int j = 0; j < n; j++)
+            {
+                int i = i0 + j;
+                int k = bestk[j];
+                if (r->cityCapital[i] != k)
+                    p->changed++;
+                p->inertia += best[j];
+                r->cityCapital[i] = k;
+                p->longsum[k] += CityLongitude[i];
+                p->latsum[k] += CityLatitude[i];
+                p->numsum[k]++;
+            }
+        }
+    }
+
+    // merge the partial sums:
+    int changed = 0;
+    *inertia = 0.;
+    for (int k = 0; k < K; k++)
+    {
+        r->capitalLongSum[k] = r->capitalLatSum[k] = 0.;
+        r->capitalNumSum[k] = 0;
+    }
+    for (int t = 0; t < r->numThreads; t++)
+    {
+        for (int k = 0; k < K; k++)
+        {
+            r->capitalLongSum[k] += r->partials[t].longsum[k];
+            r->capitalLatSum[k] += r->partials[t].latsum[k];
+            r->capitalNumSum[k] += r->partials[t].numsum[k];
+        }
+        changed += r->partials[t].changed;
+        *inertia += r->partials[t].inertia;
+    }
+    return changed;
+}
+
+// k-means with K capitals, from wherever the run's capitals are now; returns the number of iterations
+int Cluster(struct run *r, int K, double *inertia)
+{
+    for (int i = 0; i < NumCities; i++)
+        r->cityCapital[i] = -1;
+
+    int iterations = 0;
+    for (int n = 0; n < MAXITERATIONS; n++)
+    {
+        int changed = Assign(r, K, inertia);
+        iterations++;
+
+        float maxShift = 0.;
+        for (int k = 0; k < K; k++)
+        {
+            if (r->capitalNumSum[k] == 0) // nobody likes this capital, leave it where it is
+                continue;
+            float longitude = r->capitalLongSum[k] / r->capitalNumSum[k];
+            float latitude = r->capitalLatSum[k] / r->capitalNumSum[k];
+            float dx = longitude - r->capitalLongitude[k];
+            float dy = latitude - r->capitalLatitude[k];
+            float shift = sqrtf(dx * dx + dy * dy);
+            if (shift > maxShift)
+                maxShift = shift;
+            r->capitalLongitude[k] = longitude;
+            r->capitalLatitude[k] = latitude;
+        }
+
+        if (changed == 0 || maxShift < TOLERANCE)
+            break;
+    }
+    return iterations;
+}
+
+// the mean silhouette of numSamples cities spread evenly through the list, with the run's assignment:
+// for each one, a = its mean distance to the other sampled cities of its own capital,
+// b = its smallest mean distance to the sampled cities of another capital, and s = (b-a) / max(a,b)
+double Silhouette(struct run *r, int K, int numSamples)
+{
+    if (numSamples > NumCities)
+        numSamples = NumCities;
+    int *cityCapital = r->cityCapital;
+    int *sample = new int[numSamples];
+    int *sampleCount = new int[K]();
+    for (int s = 0; s < numSamples; s++)
+    {
+        sample[s] = (int)((long)s * NumCities / numSamples);
+        sampleCount[cityCapital[sample[s]]]++;
+    }
+
+    double total = 0.;
+#pragma omp parallel num_threads(r->numThreads) reduction(+ : total)
+    {
+        double *distsum = r->partials[omp_get_thread_num()].distsum;
+#pragma omp for schedule(dynamic, 16)
+        for (int s = 0; s < numSamples; s++)
+        {
+            int i = sample[s];
+            for (int k = 0; k < K; k++)
+                distsum[k] = 0.;
+            for (int t = 0; t < numSamples; t++)
+            {
+                int j = sample[t];
+                float dx = CityLongitude[i] - CityLongitude[j];
+                float dy = CityLatitude[i] - CityLatitude[j];
+                distsum[cityCapital[j]] += sqrtf(dx * dx + dy * dy);
+            }
+
+            int own = cityCapital[i];
+            if (sampleCount[own] <= 1) // alone in its cluster: s = 0
+                continue;
+            double a = distsum[own] / (sampleCount[own] - 1);
+            double b = INFINITY;
+            for (int k = 0; k < K; k++)
+            {
+                if (k != own && sampleCount[k] > 0 && distsum[k] / sampleCount[k] < b)
+                    b = distsum[k] / sampleCount[k];
+            }
+            if (b == INFINITY) // only one cluster was sampled
+                continue;
+            double m = a > b ? a : b;
+            if (m > 0.)
+                total += (b - a) / m;
+        }
+    }
+
+    delete[] sample;
+    delete[] sampleCount;
+    return total / numSamples;
+}
+
+// one restart on run r: seed it, cluster it, and remember its capitals if they are the best this run has seen
+// (a single run keeps the seeding that was asked for; restarts are k-means++ from seeds seed, seed+1, ...)
+double Restart(struct run *r, int K, int restart, int numRestarts, bool plusPlus, unsigned int seed, int numFileCities)
+{
+    if (plusPlus || numRestarts > 1)
+        SeedPlusPlus(CityLongitude, CityLatitude, 1, NumCities, K, seed + restart, r->cityDistance2,
+                     r->capitalLongitude, r->capitalLatitude, r->numThreads);
+    else
+        SeedStride(CityLongitude, CityLatitude, 1, numFileCities, K, r->capitalLongitude, r->capitalLatitude);
+    double inertia;
+    int iterations = Cluster(r, K, &inertia);
+    r->iterations += iterations;
+    if (inertia < r->bestInertia)
+    {
+        r->bestInertia = inertia;
+        r->bestIterations = iterations;
+        for (int k = 0; k < K; k++)
+        {
+            r->bestLongitude[k] = r->capitalLongitude[k];
+            r->bestLatitude[k] = r->capitalLatitude[k];
+        }
+    }
+    return inertia;
+}
+
+// the elbow: scale K and the inertia to 0.-1., and take the K whose point lies farthest below
+// the straight line from the first K to the last one
+int Elbow(struct result *results, int numResults)
+{
+    if (numResults < 3)
+        return results[0].k;
+    double kLo = results[0].k, kHi = results[numResults - 1].k;
+    double iLo = results[0].inertia, iHi = results[0].inertia;
+    for (int r = 0; r < numResults; r++)
+    {
+        iLo = fmin(iLo, results[r].inertia);
+        iHi = fmax(iHi, results[r].inertia);
+    }
+    if (iHi == iLo)
+        return results[0].k;
+
+    int best = 0;
+    double bestGap = -INFINITY;
+    for (int r = 0; r < numResults; r++)
+    {
+        double x = (results[r].k - kLo) / (kHi - kLo);
+        double y = (results[r].inertia - iLo) / (iHi - iLo);
+        if ((1. - x) - y > bestGap)
+        {
+            bestGap = (1. - x) - y;
+            best = r;
+        }
+    }
+    return results[best].k;
+}
+
+void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-k first:last[:step]] [-t threads] [-i stride|plusplus] [-r seed] [-R restarts] [-m auto|concurrent|sequential] [-s samples] [-c copies] [datafile]\n", prog);
+    fprintf(stderr, "\t-k first:last:step  the numbers of capitals to try (default 2:50:1)\n");
+    fprintf(stderr, "\t-t threads          how many threads (default %d)\n", NUMT);
+    fprintf(stderr, "\t-i seeding          stride (like proj03) or plusplus (k-means++, with random seed -r)\n");
+    fprintf(stderr, "\t-R restarts         cluster every K this many times from k-means++ seeds -r, -r+1, ... and keep the best\n");
+    fprintf(stderr, "\t-m mode             run the restarts concurrently on groups of threads, or one after the other\n");
+    fprintf(stderr, "\t                    with all the threads (default: auto, concurrent for small problems)\n");
+    fprintf(stderr, "\t-s samples          how many cities the silhouette looks at (default %d)\n", SAMPLES);
+    fprintf(stderr, "\t-c copies           cluster this many jittered copies of the data file\n");
+    fprintf(stderr, "\tdatafile            CSV or binary point file (default %s)\n", DATAFILE);
+}
+
+enum mode { AUTO, CONCURRENT, SEQUENTIAL };
+const char *ModeNames[] = { "auto", "concurrent", "sequential" };
+
+int main(int argc, char *argv[])
+{
+    int kFirst = 2, kLast = 50, kStep = 1;
+    int numSamples = SAMPLES;
+    int copies = 1;
+    bool plusPlus = false;
+    unsigned int seed = 0;
+    int numRestarts = 1;
+    int mode = AUTO;
+    const char *dataFile = DATAFILE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+        {
+            kStep = 1;
+            if (sscanf(argv[++i], "%d:%d:%d", &kFirst, &kLast, &kStep) < 2)
+                kFirst = kLast = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            NumThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "stride") == 0 || strcmp(argv[i + 1], "plusplus") == 0))
+            plusPlus = strcmp(argv[++i], "plusplus") == 0;
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            seed = (unsigned int)atol(argv[++i]);
+        else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+            numRestarts = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+        {
+            i++;
+            for (mode = SEQUENTIAL; mode > AUTO && strcmp(argv[i], ModeNames[mode]) != 0; mode--)
+                ;
+            if (strcmp(argv[i], ModeNames[mode]) != 0)
+            {
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            numSamples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            copies = atoi(argv[++i]);
+        else if (argv[i][0] != '-')
+            dataFile = argv[i];
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (kFirst < 1 || kLast < kFirst || kStep < 1 || NumThreads < 1 || numSamples < 2 || copies < 1 || numRestarts < 1)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    omp_set_num_threads(NumThreads);
+    omp_set_max_active_levels(2); // the concurrent restarts' groups of threads
+
+    double time0 = omp_get_wtime();
+
+    // load the cities once, and make the copies the way proj03 does (see kmeans.h):
+    struct points points;
+    if (!LoadPoints(dataFile, NumThreads, &points))
+        return 1;
+    NumCities = points.num * copies;
+    CityLongitude = (float *)AllocAligned(NumCities * sizeof(float));
+    CityLatitude = (float *)AllocAligned(NumCities * sizeof(float));
+    CopyCities(&points, copies, CITYJITTER, CityLongitude, CityLatitude, 1);
+    if (kFirst > NumCities)
+    {
+        fprintf(stderr, "Cannot cluster %d cities into %d or more capitals\n", NumCities, kFirst);
+        free(CityLongitude);
+        free(CityLatitude);
+        FreePoints(&points);
+        return 1;
+    }
+    if (kLast > NumCities)
+        kLast = NumCities;
+
+    // and allocate everything once, for the biggest K: one run per concurrent restart
+    // (run 0 has a partial for every thread, the others are only used for groups of threads)
+    MaxCapitals = kLast;
+    int numRuns = numRestarts < NumThreads ? numRestarts : NumThreads;
+    if (mode == SEQUENTIAL)
+        numRuns = 1;
+    struct run *runs = new struct run[numRuns];
+    for (int g = 0; g < numRuns; g++)
+        AllocRun(&runs[g], g == 0 ? NumThreads : NumThreads / numRuns);
+
+    int numResults = (kLast - kFirst) / kStep + 1;
+    struct result *results = new struct result[numResults];
+    double *inertias = new double[numRestarts];
+
+    FILE *fp = fopen(CSVFILE, "a");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening CSV file!\n");
+        return 1;
+    }
+
+    // every K in turn:
+    int bestSilhouette = 0;
+    for (int r = 0; r < numResults; r++)
+    {
+        int K = kFirst + r * kStep;
+        double time1 = omp_get_wtime();
+
+        // concurrent restarts when an iteration is too little work to split over all the threads:
+        bool concurrent = numRuns > 1 &&
+                          (mode == CONCURRENT || (mode == AUTO && (double)NumCities * K < (double)CONCURRENTWORK * NumThreads));
+        int numGroups = concurrent ? numRuns : 1;
+        for (int g = 0; g < numRuns; g++)
+        {
+            runs[g].numThreads = concurrent ? NumThreads / numRuns : NumThreads;
+            runs[g].bestInertia = INFINITY;
+            runs[g].iterations = 0;
+        }
+
+#pragma omp parallel for num_threads(numGroups) schedule(dynamic, 1)
+        for (int restart = 0; restart < numRestarts; restart++)
+            inertias[restart] = Restart(&runs[omp_get_thread_num()], K, restart, numRestarts, plusPlus, seed, points.num);
+
+        // the best of all the runs' bests:
+        int best = 0;
+        for (int g = 1; g < numGroups; g++)
+        {
+            if (runs[g].bestInertia < runs[best].bestInertia)
+                best = g;
+        }
+        struct result *res = &results[r];
+        res->k = K;
+        res->concurrent = concurrent;
+        res->inertia = runs[best].bestInertia;
+        res->iterations = runs[best].bestIterations;
+        res->allIterations = 0;
+        for (int g = 0; g < numGroups; g++)
+            res->allIterations += runs[g].iterations;
+        res->meanInertia = 0.;
+        res->worstInertia = 0.;
+        for (int restart = 0; restart < numRestarts; restart++)
+        {
+            res->meanInertia += inertias[restart] / numRestarts;
+            res->worstInertia = fmax(res->worstInertia, inertias[restart]);
+        }
+        res->seconds = omp_get_wtime() - time1;
+
+        // the silhouette of the best capitals, with all the threads (run 0 has a partial for each of them):
+        runs[0].numThreads = NumThreads;
+        for (int k = 0; k < K; k++)
+        {
+            runs[0].capitalLongitude[k] = runs[best].bestLongitude[k];
+            runs[0].capitalLatitude[k] = runs[best].bestLatitude[k];
+        }
+        double inertia;
+        Assign(&runs[0], K, &inertia);
+        res->silhouette = K > 1 ? Silhouette(&runs[0], K, numSamples) : 0.;
+        if (res->silhouette > results[bestSilhouette].silhouette)
+            bestSilhouette = r;
+
+        // the throughput counts every restart's iterations, as res->seconds covers them all
+        // (so it stays comparable with the single-run rows):
+        fprintf(fp, "%2d, %4d, %4d, %3d, %10.6lf, %8.3lf, %14.4lf, %8.5lf, %3d, %d, %14.4lf, %14.4lf, %10.6lf\n",
+                NumThreads, NumCities, K, res->iterations, res->seconds,
+                (double)NumCities * (double)K * (double)res->allIterations / res->seconds / 1000000.,
+                res->inertia, res->silhouette, numRestarts, concurrent ? 1 : 0, res->meanInertia, res->worstInertia,
+                res->seconds / numRestarts);
+        if (numRestarts > 1)
+            fprintf(stderr, "K = %4d : %d restarts (%s) ; inertia best = %.4lf , mean = %.4lf , worst = %.4lf ; %.6lf sec per restart\n",
+                    K, numRestarts, concurrent ? "concurrent" : "sequential", res->inertia, res->meanInertia,
+                    res->worstInertia, res->seconds / numRestarts);
+    }
+    fclose(fp);
+
+    fprintf(stderr, "%2d threads : %d cities ; K = %d..%d ; %.3lf sec in all\n", NumThreads, NumCities, kFirst,
+            kFirst + (numResults - 1) * kStep, omp_get_wtime() - time0);
+    fprintf(stderr, "elbow K = %d ; best silhouette K = %d (%.4lf)\n", Elbow(results, numResults),
+            results[bestSilhouette].k, results[bestSilhouette].silhouette);
+
+    for (int g = 0; g < numRuns; g++)
+        FreeRun(&runs[g], g == 0 ? NumThreads : NumThreads / numRuns);
+    delete[] runs;
+    delete[] results;
+    delete[] inertias;
+    free(CityLongitude);
+    free(CityLatitude);
+    FreePoints(&points);
+    return 0;
+}
@@ -0,0 +1,19 @@
+#!/bin/bash
+# cache-tiled assignment (output/output-tiled.csv) vs the SIMD brute-force loop (output/output.csv) for big K and N:
+# a million cities, a few iterations each (the assignment throughput is what's compared, not convergence)
+# (the cities are a scratch file in a temporary directory, removed at the end)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+g++ -O3 proj03.cpp -DNUMT=4 -o proj03-tiled -lm -fopenmp
+./proj03-tiled -c 3000 -w $scratch/cities-1m.bin 2> /dev/null
+echo "capitals, brute-force megaCityCapitals/sec, tiled megaCityCapitals/sec, speedup"
+for n in 64 256 1024 4096 16384
+do
+  g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n -DMAXITERATIONS=5 -o proj03-tiled -lm -fopenmp
+  ./proj03-tiled $scratch/cities-1m.bin 2> /dev/null
+  brute=$(tail -n 1 output/output.csv | cut -d, -f4 | tr -d ' ')
+  g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n -DMAXITERATIONS=5 -DTILED -o proj03-tiled -lm -fopenmp
+  ./proj03-tiled $scratch/cities-1m.bin 2>&1 > /dev/null | grep tiled: >&2
+  tiled=$(tail -n 1 output/output-tiled.csv | cut -d, -f4 | tr -d ' ')
+  echo "$n, $brute, $tiled, $(awk "BEGIN { printf \"%.2f\", $tiled / $brute }")"
+done
@@ -0,0 +1,20 @@
+#!/bin/bash
+# weighted (output/output-weighted.csv) vs unweighted (output/output.csv) clustering throughput
+# UsCities.csv has no populations, so this makes a copy with a stand-in weight column (1 - 997, spread through the file);
+# the assignment is the same for both, only the centroid sums (doubles, one multiply more per city) differ
+# (the weighted copy is a scratch file in a temporary directory, removed at the end)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+awk -F, 'NR == 1 { print "longitude,latitude,weight,name"; next }
+         { printf "%s,%s,%d", $1, $2, 1 + (NR * 7919) % 997; for (i = 3; i <= NF; i++) printf ",%s", $i; print "" }' UsCities.csv > $scratch/UsCitiesWeighted.csv
+echo "capitals, unweighted megaCityCapitals/sec, weighted megaCityCapitals/sec, weighted / unweighted"
+for n in 5 10 20 50 100 200 500
+do
+  g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n -o proj03-weighted -lm -fopenmp
+  ./proj03-weighted -c 100 $scratch/UsCitiesWeighted.csv 2> /dev/null
+  unweighted=$(tail -n 1 output/output.csv | cut -d, -f4 | tr -d ' ')
+  g++ -O3 proj03.cpp -DNUMT=4 -DNUMCAPITALS=$n -DWEIGHTED -o proj03-weighted -lm -fopenmp
+  ./proj03-weighted -c 100 $scratch/UsCitiesWeighted.csv 2> /dev/null
+  weighted=$(tail -n 1 output/output-weighted.csv | cut -d, -f4 | tr -d ' ')
+  echo "$n, $unweighted, $weighted, $(awk "BEGIN { printf \"%.2f\", $weighted / $unweighted }")"
+done
@@ -1,11 +1,15 @@
 #!/bin/bash
 mv "output/output.csv" "output/output-$(date +"%Y%m%d_%H%M%S").csv"
 mv "output/extra-credit.csv" "output/extra-credit-$(date +"%Y%m%d_%H%M%S").csv"
-for t in 1 2 4 6 8
+[ -f "output/profile.csv" ] && mv "output/profile.csv" "output/profile-$(date +"%Y%m%d_%H%M%S").csv"
+[ -f "output/output-critical.csv" ] && mv "output/output-critical.csv" "output/output-critical-$(date +"%Y%m%d_%H%M%S").csv"
+for t in 1 2 4 6 8 12 16
 do
   for n in 2 3 4 5 10 15 20 30 40 50
   do
      g++ proj03.cpp -DNUMT=$t -DNUMCAPITALS=$n -o proj03 -lm -fopenmp
     ./proj03
+     g++ proj03.cpp -DNUMT=$t -DNUMCAPITALS=$n -DCRITICAL -o proj03 -lm -fopenmp
+    ./proj03
   done
 done
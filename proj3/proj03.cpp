@@ -3,55 +3,1368 @@
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
 #include <omp.h>
 #include <string>
 
+#include "cities.h"
+#include "kdtree.h"
+#include "kmeans.h"
+
 // setting the number of threads:
 #ifndef NUMT
 #define NUMT 2
 #endif
 
-// setting the number of capitals we want to try:
-#ifndef NUMCAPITALS
-#define NUMCAPITALS 5
+// setting the number of capitals we want to try:
+#ifndef NUMCAPITALS
+#define NUMCAPITALS 5
+#endif
+
+// maximum iterations to allow looking for convergence:
+#ifndef MAXITERATIONS
+#define MAXITERATIONS 100
+#endif
+
+// converged once no city changes capital, or no capital moves more than this (degrees):
+#ifndef TOLERANCE
+#define TOLERANCE 1.e-4
+#endif
+
+// per-iteration profile (time, changed assignments, inertia, capital shift):
+#ifndef PROFILEFILE
+#define PROFILEFILE "output/profile.csv"
+#endif
+
+// define CRITICAL to accumulate the capital sums in an omp critical section (the original way)
+// instead of in per-thread partial sums that are merged once per iteration:
+// #define CRITICAL
+
+// define AOS to keep the cities in the original array-of-structures layout
+// instead of the structure-of-arrays layout (to compare the two):
+// #define AOS
+
+// define SCALAR to find each city's nearest capital with the original Distance( ) (sqrtf) loop
+// instead of the SIMD squared-distance kernel:
+// #define SCALAR
+
+// define HAMERLY or ELKAN to skip most of the distance computations with the triangle inequality:
+// every city keeps an upper bound on the distance to its capital and lower bounds on the distances
+// to the other capitals (Hamerly: one bound for all of them, Elkan: one per capital)
+// that are loosened by how far the capitals move, and only cities whose bounds overlap are looked at again
+// #define HAMERLY
+// #define ELKAN
+
+#if defined(HAMERLY) || defined(ELKAN)
+#define BOUNDS
+#endif
+
+#if defined(HAMERLY) && defined(ELKAN)
+#error "define HAMERLY or ELKAN, not both"
+#endif
+
+#if defined(CRITICAL) && defined(BOUNDS)
+#error "the HAMERLY and ELKAN engines use the per-thread partial sums, not CRITICAL"
+#endif
+
+// define DETERMINISTIC to make the capitals (and everything else) come out bitwise the same at any NUMT:
+// the cities are summed SUMBLOCK at a time into double partial sums, one block after the other in city order,
+// and the blocks are merged into the capitals' sums in block order (an omp ordered loop), instead of each thread
+// summing whatever cities it got into float partials that are merged in thread order
+// #define DETERMINISTIC
+
+#if defined(CRITICAL) && defined(DETERMINISTIC)
+#error "DETERMINISTIC replaces the per-thread partial sums, not CRITICAL"
+#endif
+
+// define GEODESIC to cluster on the sphere instead of on the longitude-latitude plane:
+// every city and capital also gets a 3D unit vector (the cities' once, the capitals' at every update),
+// the nearest capital is the one with the largest dot product (the shortest great circle), and each new
+// capital is the spherical centroid of its cities (the mean of their unit vectors, pushed back out to the sphere).
+// The inertia is then in squared chord lengths on the unit sphere, 2 - 2 * dot.
+// Also define HAVERSINE to compare with the naive way, the haversine formula (with its trig) for every pair:
+// #define GEODESIC
+// #define HAVERSINE
+
+// define TILED for thousands of capitals: the cities are taken CITYTILE at a time, and the capitals a tile at a time,
+// a tile small enough to stay in the cache while every city in the block is compared with it (instead of the whole
+// capital list streaming through the cache for every SIMDWIDTH cities), and each capital is loaded once for TILEROWS
+// vectors of cities. The capital tile size, and whether the capitals are compared by squared distance or in the
+// GEMM form |c|^2 - 2 x.c (|x|^2 is the same for every capital, so it drops out), are timed at startup and the fastest
+// kept. The nearest capital's squared distance is then computed exactly, whichever form found it.
+// #define TILED
+
+#if defined(HAVERSINE) && !defined(GEODESIC)
+#define GEODESIC
+#endif
+
+#if defined(GEODESIC) && defined(BOUNDS)
+#error "the HAMERLY and ELKAN engines are planar only"
+#endif
+
+#if defined(TILED) && (defined(BOUNDS) || defined(GEODESIC) || defined(SCALAR))
+#error "TILED is the planar SIMD brute-force engine, not HAMERLY, ELKAN, GEODESIC or SCALAR"
+#endif
+
+// define WEIGHTED to weight every city by the weight in the data file (a population, a demand, ...):
+// the capitals become weighted centroids and the inertia a weighted sum, the assignment is unchanged.
+// The weighted sums are doubles (a float sum of millions of populations loses the small towns);
+// a data file without weights gives every city a weight of 1.
+// #define WEIGHTED
+
+// the cities are read at run time (see cities.h), from this file unless another one is named on the command line:
+#define DATAFILE "UsCities.csv"
+
+#define CITYJITTER 0.5 // degrees, plus or minus, for the extra copies made with -c
+
+#define CSV
+
+#if defined(CRITICAL)
+#define CSVACCUM "-critical"
+#elif defined(DETERMINISTIC)
+#define CSVACCUM "-deterministic"
+#else
+#define CSVACCUM ""
+#endif
+
+#ifdef AOS
+#define CSVLAYOUT "-aos"
+#else
+#define CSVLAYOUT ""
+#endif
+
+#ifdef SCALAR
+#define CSVKERNEL "-scalar"
+#else
+#define CSVKERNEL ""
+#endif
+
+#if defined(HAMERLY)
+#define CSVENGINE "-hamerly"
+#elif defined(ELKAN)
+#define CSVENGINE "-elkan"
+#elif defined(TILED)
+#define CSVENGINE "-tiled"
+#else
+#define CSVENGINE ""
+#endif
+
+#if defined(HAVERSINE)
+#define CSVMETRIC "-haversine"
+#elif defined(GEODESIC)
+#define CSVMETRIC "-geodesic"
+#else
+#define CSVMETRIC ""
+#endif
+
+#ifdef WEIGHTED
+#define CSVWEIGHT "-weighted"
+#else
+#define CSVWEIGHT ""
+#endif
+
+#define CSVFILE "output/output" CSVACCUM CSVLAYOUT CSVKERNEL CSVENGINE CSVMETRIC CSVWEIGHT ".csv"
+
+// SIMD width of the nearest-capital kernel, whatever the compiler was told the cpu has (-march=native, -mavx, ...):
+#if defined(__AVX512F__)
+#define SIMDWIDTH 16
+#elif defined(__AVX__)
+#define SIMDWIDTH 8
+#else
+#define SIMDWIDTH 4 // SSE, every x86-64 has it
+#endif
+
+typedef float vfloat __attribute__((vector_size(4 * SIMDWIDTH)));
+typedef int vint __attribute__((vector_size(4 * SIMDWIDTH)));
+
+// the capital arrays are padded to a whole number of SIMD vectors:
+#define NUMCAPITALSPADDED (((NUMCAPITALS + SIMDWIDTH - 1) / SIMDWIDTH) * SIMDWIDTH)
+
+#define ALIGNED __attribute__((aligned(64)))
+
+// the assignment loops hand the kernels this many cities at a time:
+#ifdef TILED
+#define CITYTILE 256 // cities per block, a multiple of TILEROWS vectors
+#define TILEROWS 4   // city vectors that share every capital load
+#define CITYBLOCK CITYTILE
+#define TILEMIN 16                  // the smallest capital tile tried
+#define TUNEDISTANCES (1L << 25)    // about how many city-capital distances each tuning try computes
+#define TUNETRIES 2                 // and how many times (the fastest counts)
+#else
+#define CITYBLOCK SIMDWIDTH
+#endif
+
+struct city
+{
+    std::string name;
+    float longitude;
+    float latitude;
+    int capitalnumber;
+    float mindistance;
+};
+
+// the cities in the data file:
+struct points Points;
+
+// the number of cities we cluster (CityCopies copies of the data file):
+int CityCopies = 1;
+int NumCities;
+
+// how the capitals are seeded (set from the command line, see Usage()):
+enum seeding { STRIDE, PLUSPLUS, PARALLEL, WARM };
+const char *SeedingNames[] = { "stride", "plusplus", "parallel", "warm" };
+int Seeding = STRIDE;
+unsigned int SeedingSeed = 0;
+
+// a warm start (-W) begins where a saved clustering (-S) left off, and its first iteration only finds capitals
+// for the cities 0..WarmKeep-1 don't have (the inserted ones): the others keep their saved capital
+int WarmKeep = 0;
+
+#define STATE_MAGIC 0x3154534b // "KST1"
+#define STATE_HEADERSIZE 64
+
+// the state file: this header, the float longitudes and latitudes of the capitals, then every city's int capital number
+struct stateheader
+{
+    uint32_t magic;
+    uint32_t numCapitals;
+    uint64_t numCities;
+    char unused[STATE_HEADERSIZE - 16];
+};
+
+#define SUMBLOCK 16384  // DETERMINISTIC sums the cities in blocks this big (a multiple of CITYBLOCK), in this order
+#define PARALLELROUNDS 5 // k-means|| sampling rounds
+#define OVERSAMPLING 2   // k-means|| samples about this many times NUMCAPITALS candidates per round
+
+#ifdef AOS
+// array of structures: every city drags its name along through the cache
+struct city *CityList;
+
+#define CITYLONGITUDE(i) CityList[i].longitude
+#define CITYLATITUDE(i) CityList[i].latitude
+#define CITYCAPITAL(i) CityList[i].capitalnumber
+#define CITYNAME(i) CityList[i].name
+#define CITYSTRIDE (int)(sizeof(struct city) / sizeof(float)) // from one city's longitude to the next one's, for kmeans.h
+#define CITYSTORAGE CityList // for the omp shared( ) clauses
+#else
+// structure of arrays: the hot loops only stream the floats they actually read,
+// and the names live in a side table that only the extra credit looks at
+// (with one copy the coordinates are used right where the loader put them)
+float *CityLongitude;
+float *CityLatitude;
+int *CityCapital;
+
+#define CITYLONGITUDE(i) CityLongitude[i]
+#define CITYLATITUDE(i) CityLatitude[i]
+#define CITYCAPITAL(i) CityCapital[i]
+#define CITYNAME(i) CityNameOf(i)
+#define CITYSTRIDE 1
+#define CITYSTORAGE CityLongitude, CityLatitude, CityCapital // for the omp shared( ) clauses
+#endif
+
+// every city's weight, whatever the layout (NULL if the data file has none, and WEIGHTED is not defined):
+float *CityWeight;
+
+#ifdef WEIGHTED
+#define CITYWEIGHT(i) (double)CityWeight[i]
+#define CITYWEIGHTS , CityWeight // for the omp shared( ) clauses
+#define WEIGHTSUMS , CapitalWeightSum
+#else
+#define CITYWEIGHT(i) 1.
+#define CITYWEIGHTS
+#define WEIGHTSUMS
+#endif
+
+#ifdef GEODESIC
+// every city's unit vector, whatever the layout:
+float *CityX;
+float *CityY;
+float *CityZ;
+#define CITYVECTORS , CityX, CityY, CityZ // for the omp shared( ) clauses
+#define GEOSUMS , CapitalXSum, CapitalYSum, CapitalZSum
+#else
+#define CITYVECTORS
+#define GEOSUMS
+#endif
+
+// the capitals, also as structure of arrays
+// (the padding lanes past NUMCAPITALS hold +infinity, so they are never the nearest):
+ALIGNED float CapitalLongitude[NUMCAPITALSPADDED];
+ALIGNED float CapitalLatitude[NUMCAPITALSPADDED];
+float CapitalShift[NUMCAPITALS]; // how far each capital moved in the last update
+#if defined(WEIGHTED) || defined(DETERMINISTIC)
+typedef double capitalsum; // the weighted or reproducible sums
+#else
+typedef float capitalsum;
+#endif
+capitalsum CapitalLongSum[NUMCAPITALS];
+capitalsum CapitalLatSum[NUMCAPITALS];
+int CapitalNumSum[NUMCAPITALS];
+#ifdef WEIGHTED
+double CapitalWeightSum[NUMCAPITALS];
+#endif
+std::string CapitalName[NUMCAPITALS];
+
+#ifdef GEODESIC
+// the capitals' unit vectors (the padding lanes hold NaN, which is never the largest dot product)
+// and the sums of their cities' unit vectors:
+ALIGNED float CapitalX[NUMCAPITALSPADDED];
+ALIGNED float CapitalY[NUMCAPITALSPADDED];
+ALIGNED float CapitalZ[NUMCAPITALSPADDED];
+double CapitalXSum[NUMCAPITALS];
+double CapitalYSum[NUMCAPITALS];
+double CapitalZSum[NUMCAPITALS];
+#endif
+
+// each thread's private partial sums for every capital
+// (aligned to a cache line so two threads never write into the same line):
+struct partial
+{
+    capitalsum longsum[NUMCAPITALS];
+    capitalsum latsum[NUMCAPITALS];
+    int numsum[NUMCAPITALS];
+#ifdef WEIGHTED
+    double weightsum[NUMCAPITALS];
+#endif
+#ifdef GEODESIC
+    double xsum[NUMCAPITALS];
+    double ysum[NUMCAPITALS];
+    double zsum[NUMCAPITALS];
+#endif
+    int changed;    // how many cities changed capital
+    double inertia; // sum of the (weighted) squared distances from the cities to their capitals
+    long distances; // how many city-capital distances were computed
+} ALIGNED;
+
+struct partial Partials[NUMT];
+
+#ifdef TILED
+int CapitalTile = NUMCAPITALS; // capitals per tile, chosen by TuneTiles( )
+bool TileGemm = false;         // compare |c|^2 - 2 x.c instead of the squared distances
+float TileOriginX, TileOriginY; // the cities' mean: the GEMM form works around it, so its terms stay small and precise
+ALIGNED float TileX[NUMCAPITALSPADDED];    // -2 c, relative to the origin
+ALIGNED float TileY[NUMCAPITALSPADDED];
+ALIGNED float TileNorm[NUMCAPITALSPADDED]; // |c|^2, relative to the origin
+#endif
+
+#ifdef BOUNDS
+// the triangle-inequality bounds (distances, not squared distances):
+float *CityUpper;                  // at least the distance from each city to its capital
+float CapitalHalfGap[NUMCAPITALS]; // half the distance from each capital to the nearest other one
+#ifdef HAMERLY
+float *CityLower;                  // at most the distance from each city to any other capital
+int ShiftMaxCapital;               // the capital that moved the most in the last update,
+float ShiftMax;                    // how far it moved,
+float ShiftNext;                   // and how far the one that moved second most did
+#else
+// at most the distance from each city to each capital, plus how far that capital had drifted when the bound was set
+// (so the bounds never have to be loosened one by one: the bound now is CityLowers - CapitalDrift)
+float *CityLowers;
+float CapitalDrift[NUMCAPITALS];            // how far each capital has moved, in total
+float CapitalGap[NUMCAPITALS][NUMCAPITALS]; // the distance between every two capitals
+#endif
+#endif
+
+#ifdef GEODESIC
+// the unit vector of a longitude-latitude in degrees:
+void UnitVector(float longitude, float latitude, float *x, float *y, float *z)
+{
+    float lng = longitude * (float)(M_PI / 180.);
+    float lat = latitude * (float)(M_PI / 180.);
+    *x = cosf(lat) * cosf(lng);
+    *y = cosf(lat) * sinf(lng);
+    *z = sinf(lat);
+}
+
+// the capitals' unit vectors, after they were seeded:
+void ProjectCapitals()
+{
+    for (int k = 0; k < NUMCAPITALSPADDED; k++)
+    {
+        if (k < NUMCAPITALS)
+            UnitVector(CapitalLongitude[k], CapitalLatitude[k], &CapitalX[k], &CapitalY[k], &CapitalZ[k]);
+        else
+            CapitalX[k] = CapitalY[k] = CapitalZ[k] = NAN;
+    }
+}
+#endif
+
+#ifdef GEODESIC
+// the chord length between the city and the capital on the unit sphere
+// (it grows with the great-circle distance, and it is still a metric):
+float Distance(int city, int capital)
+{
+    float dot = CityX[city] * CapitalX[capital] + CityY[city] * CapitalY[capital] + CityZ[city] * CapitalZ[capital];
+    return sqrtf(fmaxf(2.f - 2.f * dot, 0.f));
+}
+#else
+float Distance(int city, int capital)
+{
+    float dx = CITYLONGITUDE(city) - CapitalLongitude[capital];
+    float dy = CITYLATITUDE(city) - CapitalLatitude[capital];
+    return sqrtf(dx * dx + dy * dy);
+}
+#endif
+
+#ifdef HAVERSINE
+// the naive great-circle distance (as an angle, in radians), all the trig done for every city-capital pair:
+float Haversine(int city, int capital)
+{
+    float lat1 = CITYLATITUDE(city) * (float)(M_PI / 180.);
+    float lat2 = CapitalLatitude[capital] * (float)(M_PI / 180.);
+    float dlat = lat2 - lat1;
+    float dlng = (CapitalLongitude[capital] - CITYLONGITUDE(city)) * (float)(M_PI / 180.);
+    float a = sinf(dlat / 2.f) * sinf(dlat / 2.f) + cosf(lat1) * cosf(lat2) * sinf(dlng / 2.f) * sinf(dlng / 2.f);
+    return 2.f * asinf(sqrtf(fminf(a, 1.f)));
+}
+#endif
+
+// which capital is nearest to city i (and the squared distance to it):
+int NearestCapital(int i, float *mindistance2)
+{
+#if defined(HAVERSINE)
+    int capitalnumber = -1;
+    float minangle = 1.e+37;
+
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        float angle = Haversine(i, k);
+        if (angle < minangle)
+        {
+            capitalnumber = k;
+            minangle = angle;
+        }
+    }
+    float chord = 2.f * sinf(minangle / 2.f); // as a squared chord, like the dot-product kernel
+    *mindistance2 = chord * chord;
+    return capitalnumber;
+#elif defined(SCALAR)
+    int capitalnumber = -1;
+    float mindistance = 1.e+37;
+
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        float dist = Distance(i, k);
+        if (dist < mindistance)
+        {
+            capitalnumber = k;
+            mindistance = dist;
+        }
+    }
+    *mindistance2 = mindistance * mindistance;
+    return capitalnumber;
+#elif defined(GEODESIC)
+    // compare dot products with SIMDWIDTH capitals' unit vectors at a time (the largest is the nearest):
+    vfloat x = (vfloat){} + CityX[i];
+    vfloat y = (vfloat){} + CityY[i];
+    vfloat z = (vfloat){} + CityZ[i];
+    vfloat best = (vfloat){} - INFINITY;
+    vint bestk = (vint){} - 1;
+    vint k = {};
+    for (int j = 0; j < SIMDWIDTH; j++)
+        k[j] = j;
+
+    for (int kk = 0; kk < NUMCAPITALSPADDED; kk += SIMDWIDTH)
+    {
+        vfloat dot = x * *(const vfloat *)&CapitalX[kk] + y * *(const vfloat *)&CapitalY[kk] + z * *(const vfloat *)&CapitalZ[kk];
+        vint closer = dot > best;
+        best = closer ? dot : best;
+        bestk = closer ? k : bestk;
+        k += SIMDWIDTH;
+    }
+
+    int capitalnumber = bestk[0];
+    float maxdot = best[0];
+    for (int j = 1; j < SIMDWIDTH; j++)
+    {
+        if (best[j] > maxdot || (best[j] == maxdot && bestk[j] < capitalnumber))
+        {
+            capitalnumber = bestk[j];
+            maxdot = best[j];
+        }
+    }
+    *mindistance2 = fmaxf(2.f - 2.f * maxdot, 0.f);
+    return capitalnumber;
+#else
+    // compare squared distances to SIMDWIDTH capitals at a time (no sqrtf needed for an argmin),
+    // keeping a running minimum and its capital number in every lane:
+    vfloat x = (vfloat){} + CITYLONGITUDE(i);
+    vfloat y = (vfloat){} + CITYLATITUDE(i);
+    vfloat best = (vfloat){} + INFINITY;
+    vint bestk = (vint){} - 1;
+    vint k = {};
+    for (int j = 0; j < SIMDWIDTH; j++)
+        k[j] = j;
+
+    for (int kk = 0; kk < NUMCAPITALSPADDED; kk += SIMDWIDTH)
+    {
+        vfloat dx = x - *(const vfloat *)&CapitalLongitude[kk];
+        vfloat dy = y - *(const vfloat *)&CapitalLatitude[kk];
+        vfloat d2 = dx * dx + dy * dy;
+        vint closer = d2 < best;
+        best = closer ? d2 : best;
+        bestk = closer ? k : bestk;
+        k += SIMDWIDTH;
+    }
+
+    // then the minimum across the lanes (lowest capital number on a tie, like the scalar loop):
+    int capitalnumber = bestk[0];
+    float mindistance = best[0];
+    for (int j = 1; j < SIMDWIDTH; j++)
+    {
+        if (best[j] < mindistance || (best[j] == mindistance && bestk[j] < capitalnumber))
+        {
+            capitalnumber = bestk[j];
+            mindistance = best[j];
+        }
+    }
+    *mindistance2 = mindistance;
+    return capitalnumber;
+#endif
+}
+
+#ifdef TILED
+// once per iteration, before the assignment: the capitals in the GEMM form
+void PrepareTiles()
+{
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        float cx = CapitalLongitude[k] - TileOriginX;
+        float cy = CapitalLatitude[k] - TileOriginY;
+        TileX[k] = -2.f * cx;
+        TileY[k] = -2.f * cy;
+        TileNorm[k] = cx * cx + cy * cy;
+    }
+}
+
+// which capital is nearest to each of the n (up to CITYTILE) cities starting at city i, a tile of capitals at a time:
+void NearestCapitalsTiled(int i, int n, int *capitalnumbers, float *mindistances2)
+{
+    // the block's cities, SIMDWIDTH to a vector, in whole groups of TILEROWS vectors
+    // (the lanes past the last city just redo the first one):
+    vfloat x[CITYTILE / SIMDWIDTH], y[CITYTILE / SIMDWIDTH], best[CITYTILE / SIMDWIDTH];
+    vint bestk[CITYTILE / SIMDWIDTH];
+    int numVectors = (n + SIMDWIDTH * TILEROWS - 1) / (SIMDWIDTH * TILEROWS) * TILEROWS;
+    float originX = TileGemm ? TileOriginX : 0.f;
+    float originY = TileGemm ? TileOriginY : 0.f;
+    for (int v = 0; v < numVectors; v++)
+    {
+        for (int j = 0; j < SIMDWIDTH; j++)
+        {
+            int c = v * SIMDWIDTH + j < n ? i + v * SIMDWIDTH + j : i;
+            x[v][j] = CITYLONGITUDE(c) - originX;
+            y[v][j] = CITYLATITUDE(c) - originY;
+        }
+        best[v] = (vfloat){} + INFINITY;
+        bestk[v] = (vint){} - 1;
+    }
+
+    for (int k0 = 0; k0 < NUMCAPITALS; k0 += CapitalTile)
+    {
+        int k1 = k0 + CapitalTile < NUMCAPITALS ? k0 + CapitalTile : NUMCAPITALS;
+        for (int v = 0; v < numVectors; v += TILEROWS)
+        {
+            // TILEROWS vectors of cities against the whole tile, their running minimums kept in registers:
+            vfloat rx[TILEROWS], ry[TILEROWS], rbest[TILEROWS];
+            vint rbestk[TILEROWS];
+            for (int r = 0; r < TILEROWS; r++)
+            {
+                rx[r] = x[v + r];
+                ry[r] = y[v + r];
+                rbest[r] = best[v + r];
+                rbestk[r] = bestk[v + r];
+            }
+            if (TileGemm)
+            {
+                for (int k = k0; k < k1; k++)
+                {
+                    float cx = TileX[k], cy = TileY[k], cn = TileNorm[k];
+                    for (int r = 0; r < TILEROWS; r++)
+                    {
+                        vfloat d2 = cn + rx[r] * cx + ry[r] * cy; // the squared distance, less |x|^2
+                        vint closer = d2 < rbest[r];
+                        rbest[r] = closer ? d2 : rbest[r];
+                        rbestk[r] = closer ? (vint){} + k : rbestk[r];
+                    }
+                }
+            }
+            else
+            {
+                for (int k = k0; k < k1; k++)
+                {
+                    float cx = CapitalLongitude[k], cy = CapitalLatitude[k];
+                    for (int r = 0; r < TILEROWS; r++)
+                    {
+                        vfloat dx = rx[r] - cx;
+                        vfloat dy = ry[r] - cy;
+                        vfloat d2 = dx * dx + dy * dy;
+                        vint closer = d2 < rbest[r];
+                        rbest[r] = closer ? d2 : rbest[r];
+                        rbestk[r] = closer ? (vint){} + k : rbestk[r];
+                    }
+                }
+            }
+            for (int r = 0; r < TILEROWS; r++)
+            {
+                best[v + r] = rbest[r];
+                bestk[v + r] = rbestk[r];
+            }
+        }
+    }
+
+    for (int c = 0; c < n; c++)
+    {
+        int k = bestk[c / SIMDWIDTH][c % SIMDWIDTH];
+        float dx = CITYLONGITUDE(i + c) - CapitalLongitude[k];
+        float dy = CITYLATITUDE(i + c) - CapitalLatitude[k];
+        capitalnumbers[c] = k;
+        mindistances2[c] = dx * dx + dy * dy;
+    }
+}
+
+// time the capital tile sizes and both forms on some of the cities, and keep the fastest:
+void TuneTiles()
+{
+    double sumX = 0., sumY = 0.;
+#pragma omp parallel for default(none) shared(NumCities, CITYSTORAGE) reduction(+ : sumX, sumY)
+    for (int i = 0; i < NumCities; i++)
+    {
+        sumX += CITYLONGITUDE(i);
+        sumY += CITYLATITUDE(i);
+    }
+    TileOriginX = (float)(sumX / NumCities);
+    TileOriginY = (float)(sumY / NumCities);
+    PrepareTiles();
+
+    // about TUNEDISTANCES city-capital distances per try, but at least a block for every thread:
+    long sample = TUNEDISTANCES / NUMCAPITALS;
+    if (sample < (long)CITYTILE * NUMT)
+        sample = (long)CITYTILE * NUMT;
+    if (sample > NumCities)
+        sample = NumCities;
+
+    double time0 = omp_get_wtime();
+    double bestTime = INFINITY;
+    int bestTile = NUMCAPITALS;
+    bool bestGemm = false;
+    for (int gemm = 0; gemm < 2; gemm++)
+    {
+        for (int tile = TILEMIN; ; tile *= 2)
+        {
+            if (tile > NUMCAPITALS)
+                tile = NUMCAPITALS;
+            CapitalTile = tile;
+            TileGemm = gemm;
+            double tryTime = INFINITY;
+            for (int t = 0; t < TUNETRIES; t++)
+            {
+                double try0 = omp_get_wtime();
+#pragma omp parallel for default(none) shared(sample)
+                for (int i0 = 0; i0 < sample; i0 += CITYTILE)
+                {
+                    int n = sample - i0 < CITYTILE ? sample - i0 : CITYTILE;
+                    int capitalnumbers[CITYTILE];
+                    float mindistances2[CITYTILE];
+                    NearestCapitalsTiled(i0, n, capitalnumbers, mindistances2);
+                }
+                double try1 = omp_get_wtime();
+                if (try1 - try0 < tryTime)
+                    tryTime = try1 - try0;
+            }
+            if (tryTime < bestTime)
+            {
+                bestTime = tryTime;
+                bestTile = tile;
+                bestGemm = gemm;
+            }
+            if (tile == NUMCAPITALS)
+                break;
+        }
+    }
+    CapitalTile = bestTile;
+    TileGemm = bestGemm;
+    fprintf(stderr, "tiled: %d-capital tiles, %s form, tuned on %ld cities in %.4lf sec\n", CapitalTile,
+            TileGemm ? "GEMM" : "distance", sample, omp_get_wtime() - time0);
+}
+#endif
+
+// which capital is nearest to each of the n cities starting at city i (and the squared distances to them):
+void NearestCapitals(int i, int n, int *capitalnumbers, float *mindistances2)
+{
+#if defined(TILED)
+    NearestCapitalsTiled(i, n, capitalnumbers, mindistances2);
+    return;
+#elif defined(GEODESIC) && !defined(SCALAR) && !defined(HAVERSINE)
+    if (n == SIMDWIDTH)
+    {
+        // a whole vector of cities, one city per lane, against every capital's unit vector:
+        vfloat x = *(const vfloat *)&CityX[i];
+        vfloat y = *(const vfloat *)&CityY[i];
+        vfloat z = *(const vfloat *)&CityZ[i];
+        vfloat best = (vfloat){} - INFINITY;
+        vint bestk = (vint){} - 1;
+
+        for (int k = 0; k < NUMCAPITALS; k++)
+        {
+            vfloat dot = x * CapitalX[k] + y * CapitalY[k] + z * CapitalZ[k];
+            vint closer = dot > best;
+            best = closer ? dot : best;
+            bestk = closer ? (vint){} + k : bestk;
+        }
+
+        for (int j = 0; j < SIMDWIDTH; j++)
+        {
+            capitalnumbers[j] = bestk[j];
+            mindistances2[j] = fmaxf(2.f - 2.f * best[j], 0.f);
+        }
+        return;
+    }
+#elif !defined(SCALAR) && !defined(HAVERSINE)
+    if (n == SIMDWIDTH)
+    {
+        // a whole vector of cities, one city per lane: walk the capitals once for all of them
+        // (no padding lanes and no cross-lane minimum needed, however few capitals there are)
+        vfloat x, y;
+        for (int j = 0; j < SIMDWIDTH; j++)
+        {
+            x[j] = CITYLONGITUDE(i + j);
+            y[j] = CITYLATITUDE(i + j);
+        }
+        vfloat best = (vfloat){} + INFINITY;
+        vint bestk = (vint){} - 1;
+
+        for (int k = 0; k < NUMCAPITALS; k++)
+        {
+            vfloat dx = x - CapitalLongitude[k];
+            vfloat dy = y - CapitalLatitude[k];
+            vfloat d2 = dx * dx + dy * dy;
+            vint closer = d2 < best;
+            best = closer ? d2 : best;
+            bestk = closer ? (vint){} + k : bestk;
+        }
+
+        for (int j = 0; j < SIMDWIDTH; j++)
+        {
+            capitalnumbers[j] = bestk[j];
+            mindistances2[j] = best[j];
+        }
+        return;
+    }
+#endif
+    for (int j = 0; j < n; j++)
+        capitalnumbers[j] = NearestCapital(i + j, &mindistances2[j]);
+}
+
+#ifdef BOUNDS
+// once per iteration, before the assignment: the distances between the capitals
+// (and for Hamerly, the two biggest capital moves)
+void PrepareBounds()
+{
+#pragma omp parallel for
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        float nearest = INFINITY;
+        for (int j = 0; j < NUMCAPITALS; j++)
+        {
+            float dx = CapitalLongitude[k] - CapitalLongitude[j];
+            float dy = CapitalLatitude[k] - CapitalLatitude[j];
+            float gap = sqrtf(dx * dx + dy * dy);
+#ifdef ELKAN
+            CapitalGap[k][j] = gap;
+#endif
+            if (j != k && gap < nearest)
+                nearest = gap;
+        }
+        CapitalHalfGap[k] = 0.5f * nearest;
+    }
+
+#ifndef HAMERLY
+    for (int k = 0; k < NUMCAPITALS; k++)
+        CapitalDrift[k] += CapitalShift[k];
+#endif
+
+#ifdef HAMERLY
+    ShiftMaxCapital = 0;
+    ShiftMax = ShiftNext = 0.;
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        if (CapitalShift[k] > ShiftMax)
+        {
+            ShiftNext = ShiftMax;
+            ShiftMax = CapitalShift[k];
+            ShiftMaxCapital = k;
+        }
+        else if (CapitalShift[k] > ShiftNext)
+        {
+            ShiftNext = CapitalShift[k];
+        }
+    }
+#endif
+}
+
+// which capital is nearest to city i, looking at as few capitals as the bounds allow:
+int BoundedCapital(int i, float *mindistance2, long *distances)
+{
+    int a = CITYCAPITAL(i);
+#ifdef HAMERLY
+    if (a >= 0)
+    {
+        // the capitals moved since the bounds were set, loosen them by that much:
+        CityUpper[i] += CapitalShift[a];
+        CityLower[i] -= a == ShiftMaxCapital ? ShiftNext : ShiftMax;
+
+        // no other capital can be closer than this:
+        float m = fmaxf(CapitalHalfGap[a], CityLower[i]);
+        if (CityUpper[i] > m)
+        {
+            CityUpper[i] = Distance(i, a);
+            (*distances)++;
+        }
+        if (CityUpper[i] <= m)
+        {
+            *mindistance2 = CityUpper[i] * CityUpper[i];
+            return a;
+        }
+    }
+
+    // look at all the capitals, remembering the nearest and the second nearest:
+    float best2 = INFINITY, second2 = INFINITY;
+    int best = -1;
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        float dx = CITYLONGITUDE(i) - CapitalLongitude[k];
+        float dy = CITYLATITUDE(i) - CapitalLatitude[k];
+        float d2 = dx * dx + dy * dy;
+        if (d2 < best2)
+        {
+            second2 = best2;
+            best2 = d2;
+            best = k;
+        }
+        else if (d2 < second2)
+        {
+            second2 = d2;
+        }
+    }
+    *distances += NUMCAPITALS;
+    CityUpper[i] = sqrtf(best2);
+    CityLower[i] = sqrtf(second2);
+    *mindistance2 = best2;
+    return best;
+#else
+    float *lower = &CityLowers[(size_t)i * NUMCAPITALS];
+    if (a < 0)
+    {
+        // the first time, every distance is a (tight) lower bound:
+        float best = INFINITY;
+        for (int k = 0; k < NUMCAPITALS; k++)
+        {
+            float d = Distance(i, k);
+            lower[k] = d + CapitalDrift[k];
+            if (d < best)
+            {
+                best = d;
+                a = k;
+            }
+        }
+        *distances += NUMCAPITALS;
+        CityUpper[i] = best;
+        *mindistance2 = best * best;
+        return a;
+    }
+
+    // the capital moved since the bound was set, loosen it by that much:
+    float u = CityUpper[i] + CapitalShift[a];
+
+    bool tight = false; // is u the actual distance yet?
+    if (u > CapitalHalfGap[a])
+    {
+        for (int k = 0; k < NUMCAPITALS; k++)
+        {
+            // capital k can only be closer if both of these say it might be:
+            if (k == a || u <= lower[k] - CapitalDrift[k] || u <= 0.5f * CapitalGap[a][k])
+                continue;
+            if (!tight)
+            {
+                u = Distance(i, a);
+                lower[a] = u + CapitalDrift[a];
+                (*distances)++;
+                tight = true;
+                if (u <= lower[k] - CapitalDrift[k] || u <= 0.5f * CapitalGap[a][k])
+                    continue;
+            }
+            float d = Distance(i, k);
+            lower[k] = d + CapitalDrift[k];
+            (*distances)++;
+            if (d < u)
+            {
+                a = k;
+                u = d;
+            }
+        }
+    }
+    CityUpper[i] = u;
+    *mindistance2 = u * u;
+    return a;
+#endif
+}
+
+// the same for each of the n cities starting at city i:
+void BoundedCapitals(int i, int n, int *capitalnumbers, float *mindistances2, long *distances)
+{
+    for (int j = 0; j < n; j++)
+        capitalnumbers[j] = BoundedCapital(i + j, &mindistances2[j], distances);
+}
+#endif
+
+// the name of city i (the binary files have no names, so those cities go by their number in the file):
+std::string CityNameOf(int i)
+{
+    int j = i % Points.num;
+    if (Points.name != NULL)
+        return Points.name[j];
+    return "#" + std::to_string(j);
+}
+
+// point the city storage at the loaded cities, making CityCopies copies of them
+// (copy 0 is exact, the others are jittered so the clustering still has work to do):
+void LoadCities()
+{
+    NumCities = Points.num * CityCopies;
+#ifdef AOS
+    CityList = new struct city[NumCities];
+#else
+    CityCapital = (int *)AllocAligned(NumCities * sizeof(int));
+    if (CityCopies == 1)
+    {
+        CityLongitude = Points.longitude;
+        CityLatitude = Points.latitude;
+    }
+    else
+    {
+        CityLongitude = (float *)AllocAligned(PaddedCount(NumCities) * sizeof(float));
+        CityLatitude = (float *)AllocAligned(PaddedCount(NumCities) * sizeof(float));
+    }
 #endif
 
-// maximum iterations to allow looking for convergence:
-#define MAXITERATIONS 100
+#ifndef AOS
+    if (CityCopies != 1)
+#endif
+        CopyCities(&Points, CityCopies, CITYJITTER, &CITYLONGITUDE(0), &CITYLATITUDE(0), CITYSTRIDE);
+    for (int i = 0; i < NumCities; i++)
+    {
+#ifdef AOS
+        CityList[i].name = CityNameOf(i);
+#endif
+        CITYCAPITAL(i) = -1;
+    }
 
-#define CSV
+    // the weights are not jittered, every copy of a city weighs the same:
+#ifdef WEIGHTED
+    if (Points.weight == NULL || CityCopies != 1)
+#else
+    if (Points.weight != NULL && CityCopies != 1)
+#endif
+    {
+        CityWeight = (float *)AllocAligned(PaddedCount(NumCities) * sizeof(float));
+#pragma omp parallel for
+        for (int i = 0; i < NumCities; i++)
+            CityWeight[i] = Points.weight != NULL ? Points.weight[i % Points.num] : 1.f;
+    }
+    else
+    {
+        CityWeight = Points.weight;
+    }
 
-struct city
+#ifdef GEODESIC
+    CityX = (float *)AllocAligned(PaddedCount(NumCities) * sizeof(float));
+    CityY = (float *)AllocAligned(PaddedCount(NumCities) * sizeof(float));
+    CityZ = (float *)AllocAligned(PaddedCount(NumCities) * sizeof(float));
+#pragma omp parallel for
+    for (int i = 0; i < NumCities; i++)
+        UnitVector(CITYLONGITUDE(i), CITYLATITUDE(i), &CityX[i], &CityY[i], &CityZ[i]);
+#endif
+
+#ifdef BOUNDS
+    CityUpper = (float *)AllocAligned(NumCities * sizeof(float));
+#ifdef HAMERLY
+    CityLower = (float *)AllocAligned(NumCities * sizeof(float));
+#else
+    CityLowers = (float *)AllocAligned((size_t)NumCities * NUMCAPITALS * sizeof(float));
+#endif
+#endif
+}
+
+// save the capitals and every city's capital number, for a later warm start:
+bool SaveState(const char *fileName)
 {
-    std::string name;
-    float longitude;
-    float latitude;
-    int capitalnumber;
-    float mindistance;
-};
+    FILE *fp = fopen(fileName, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Cannot write state file '%s'\n", fileName);
+        return false;
+    }
+    struct stateheader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = STATE_MAGIC;
+    header.numCapitals = NUMCAPITALS;
+    header.numCities = NumCities;
 
-#include "UsCities.data"
+    int *capitals = new int[NumCities];
+    for (int i = 0; i < NumCities; i++)
+        capitals[i] = CITYCAPITAL(i);
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(CapitalLongitude, sizeof(float), NUMCAPITALS, fp) == NUMCAPITALS;
+    ok = ok && fwrite(CapitalLatitude, sizeof(float), NUMCAPITALS, fp) == NUMCAPITALS;
+    ok = ok && fwrite(capitals, sizeof(int), NumCities, fp) == (size_t)NumCities;
+    fclose(fp);
+    delete[] capitals;
+    if (!ok)
+        fprintf(stderr, "Cannot write state file '%s'\n", fileName);
+    return ok;
+}
 
-// setting the number of cities we want to try:
-#define NUMCITIES (sizeof(Cities) / sizeof(struct city))
+// read a saved state into the capitals and into capitals[ ], the capital numbers of the numCities cities it was saved with:
+bool LoadState(const char *fileName, int numCities, int *capitals)
+{
+    FILE *fp = fopen(fileName, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Cannot open state file '%s'\n", fileName);
+        return false;
+    }
+    struct stateheader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != STATE_MAGIC)
+    {
+        fprintf(stderr, "'%s' is not a state file (proj03 -S makes one)\n", fileName);
+        fclose(fp);
+        return false;
+    }
+    if (header.numCapitals != NUMCAPITALS || header.numCities != (uint64_t)numCities)
+    {
+        fprintf(stderr, "'%s' is a state of %d cities and %d capitals, not %d and %d\n", fileName,
+                (int)header.numCities, (int)header.numCapitals, numCities, NUMCAPITALS);
+        fclose(fp);
+        return false;
+    }
+    bool ok = fread(CapitalLongitude, sizeof(float), NUMCAPITALS, fp) == NUMCAPITALS;
+    ok = ok && fread(CapitalLatitude, sizeof(float), NUMCAPITALS, fp) == NUMCAPITALS;
+    ok = ok && fread(capitals, sizeof(int), numCities, fp) == (size_t)numCities;
+    fclose(fp);
+    for (int i = 0; ok && i < numCities; i++)
+        ok = capitals[i] >= 0 && capitals[i] < NUMCAPITALS;
+    if (!ok)
+        fprintf(stderr, "Cannot read state file '%s'\n", fileName);
+    return ok;
+}
 
-struct capital
+// a warm start's first iteration: the cities keep their saved capitals (one distance each, for the inertia)
+void KeepCapitals(int i, int n, int *capitalnumbers, float *mindistances2)
 {
-    std::string name;
-    float longitude;
-    float latitude;
-    float longsum;
-    float latsum;
-    int numsum;
-};
+    for (int j = 0; j < n; j++)
+    {
+        capitalnumbers[j] = CITYCAPITAL(i + j);
+        float d = Distance(i + j, capitalnumbers[j]);
+        mindistances2[j] = d * d;
+    }
+}
 
-struct capital Capitals[NUMCAPITALS];
+// a random number in [0.,1.) that only depends on (seed, round, i), not on which thread asks for it,
+// so the k-means|| samples are the same with any number of threads:
+float HashRanf(unsigned int seed, unsigned int round, unsigned int i)
+{
+    uint64_t z = (((uint64_t)seed << 32) | round) * 0x9e3779b97f4a7c15ull + (uint64_t)i * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return (float)(z >> 40) / 16777216.f;
+}
 
-float Distance(int city, int capital)
+// pick the capitals at uniform intervals through the data file (the original way):
+void SeedStride()
 {
-    float dx = Cities[city].longitude - Capitals[capital].longitude;
-    float dy = Cities[city].latitude - Capitals[capital].latitude;
-    return sqrtf(dx * dx + dy * dy);
+    SeedStride(&CITYLONGITUDE(0), &CITYLATITUDE(0), CITYSTRIDE, Points.num, NUMCAPITALS, CapitalLongitude, CapitalLatitude);
+}
+
+// lower every city's squared distance to its nearest capital so far, d2[i], for a new capital at (x, y):
+void LowerDistances(float *d2, float x, float y)
+{
+    LowerDistances(&CITYLONGITUDE(0), &CITYLATITUDE(0), CITYSTRIDE, NumCities, d2, x, y, NUMT);
+}
+
+// k-means++ (see kmeans.h), from seed SeedingSeed
+void SeedPlusPlus()
+{
+    float *d2 = (float *)AllocAligned(NumCities * sizeof(float));
+    SeedPlusPlus(&CITYLONGITUDE(0), &CITYLATITUDE(0), CITYSTRIDE, NumCities, NUMCAPITALS, SeedingSeed, d2,
+                 CapitalLongitude, CapitalLatitude, NUMT);
+    free(d2);
+}
+
+// k-means|| (scalable k-means++): a few rounds that each sample about OVERSAMPLING * NUMCAPITALS cities at once,
+// every city independently with probability proportional to its squared distance to the nearest sample so far,
+// then a weighted k-means++ over the samples (each weighted by how many cities are nearest to it)
+void SeedParallel()
+{
+    unsigned int seed = SeedingSeed;
+    float *d2 = (float *)AllocAligned(NumCities * sizeof(float));
+    int maxCandidates = 1 + PARALLELROUNDS * 2 * OVERSAMPLING * NUMCAPITALS; // twice what is expected, then stop sampling
+    float *candidateLongitude = new float[maxCandidates];
+    float *candidateLatitude = new float[maxCandidates];
+    int numCandidates = 0;
+    int numBlocks = (NumCities + SEEDBLOCK - 1) / SEEDBLOCK;
+    int *blockStarts = new int[numBlocks];
+
+    int first = rand_r(&seed) % NumCities;
+    candidateLongitude[numCandidates] = CITYLONGITUDE(first);
+    candidateLatitude[numCandidates] = CITYLATITUDE(first);
+    numCandidates++;
+#pragma omp parallel for
+    for (int i = 0; i < NumCities; i++)
+        d2[i] = INFINITY;
+    LowerDistances(d2, candidateLongitude[0], candidateLatitude[0]);
+
+    for (int round = 0; round < PARALLELROUNDS && numCandidates < maxCandidates; round++)
+    {
+        double total = 0.;
+#pragma omp parallel for reduction(+ : total)
+        for (int i = 0; i < NumCities; i++)
+            total += d2[i];
+        if (total == 0.)
+            break;
+
+        // sample: count the picks in every block, then every block writes its picks after the ones
+        // of the blocks before it, so the candidates come out in city order with any number of threads
+        int roundStart = numCandidates;
+        float scale = (float)(OVERSAMPLING * NUMCAPITALS / total);
+#pragma omp parallel for
+        for (int b = 0; b < numBlocks; b++)
+        {
+            int count = 0;
+            int end = (b + 1) * SEEDBLOCK < NumCities ? (b + 1) * SEEDBLOCK : NumCities;
+            for (int i = b * SEEDBLOCK; i < end; i++)
+                count += HashRanf(seed, round, i) < d2[i] * scale;
+            blockStarts[b] = count;
+        }
+        for (int b = 0; b < numBlocks; b++)
+        {
+            int count = blockStarts[b];
+            blockStarts[b] = numCandidates;
+            numCandidates += count;
+        }
+        if (numCandidates > maxCandidates)
+            numCandidates = maxCandidates;
+#pragma omp parallel for
+        for (int b = 0; b < numBlocks; b++)
+        {
+            int c = blockStarts[b];
+            int end = (b + 1) * SEEDBLOCK < NumCities ? (b + 1) * SEEDBLOCK : NumCities;
+            for (int i = b * SEEDBLOCK; i < end && c < numCandidates; i++)
+            {
+                if (HashRanf(seed, round, i) < d2[i] * scale)
+                {
+                    candidateLongitude[c] = CITYLONGITUDE(i);
+                    candidateLatitude[c] = CITYLATITUDE(i);
+                    c++;
+                }
+            }
+        }
+
+        // the new candidates are few, so find every city's nearest one with a k-d tree over them:
+        struct kdtree tree;
+        BuildKdTree(&candidateLongitude[roundStart], &candidateLatitude[roundStart], numCandidates - roundStart, &tree);
+#pragma omp parallel for
+        for (int i = 0; i < NumCities; i++)
+        {
+            float dist2;
+            KdNearest(&tree, CITYLONGITUDE(i), CITYLATITUDE(i), &dist2);
+            if (dist2 < d2[i])
+                d2[i] = dist2;
+        }
+        FreeKdTree(&tree);
+    }
+
+    if (numCandidates < NUMCAPITALS)
+    {
+        // too few cities were different enough to sample, do it the k-means++ way:
+        free(d2);
+        delete[] candidateLongitude;
+        delete[] candidateLatitude;
+        delete[] blockStarts;
+        SeedPlusPlus();
+        return;
+    }
+
+    // weight every candidate by the number of cities nearest to it (per-thread counts, then merged):
+    struct kdtree tree;
+    BuildKdTree(candidateLongitude, candidateLatitude, numCandidates, &tree);
+    double *weights = new double[numCandidates]();
+#pragma omp parallel
+    {
+        int *counts = new int[numCandidates]();
+#pragma omp for
+        for (int i = 0; i < NumCities; i++)
+        {
+            float dist2;
+            counts[KdNearest(&tree, CITYLONGITUDE(i), CITYLATITUDE(i), &dist2)]++;
+        }
+#pragma omp critical
+        for (int c = 0; c < numCandidates; c++)
+            weights[c] += counts[c];
+        delete[] counts;
+    }
+    FreeKdTree(&tree);
+
+    // weighted k-means++ over the candidates (there are only a few of them, so this is serial):
+    float *cd2 = new float[numCandidates];
+    int pick = 0;
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        if (k > 0)
+        {
+            double total = 0.;
+            for (int c = 0; c < numCandidates; c++)
+                total += weights[c] * cd2[c];
+            double r = Ranf_r(&seed, 0., 1.) * total;
+            pick = numCandidates - 1;
+            for (int c = 0; c < numCandidates; c++)
+            {
+                if (r < weights[c] * cd2[c])
+                {
+                    pick = c;
+                    break;
+                }
+                r -= weights[c] * cd2[c];
+            }
+        }
+        else
+        {
+            // the first one with probability proportional to its weight:
+            double r = Ranf_r(&seed, 0., 1.) * NumCities;
+            for (pick = 0; pick < numCandidates - 1 && r >= weights[pick]; pick++)
+                r -= weights[pick];
+        }
+        CapitalLongitude[k] = candidateLongitude[pick];
+        CapitalLatitude[k] = candidateLatitude[pick];
+        for (int c = 0; c < numCandidates; c++)
+        {
+            float dx = candidateLongitude[c] - CapitalLongitude[k];
+            float dy = candidateLatitude[c] - CapitalLatitude[k];
+            float dist2 = dx * dx + dy * dy;
+            if (k == 0 || dist2 < cd2[c])
+                cd2[c] = dist2;
+        }
+    }
+
+    free(d2);
+    delete[] candidateLongitude;
+    delete[] candidateLatitude;
+    delete[] blockStarts;
+    delete[] weights;
+    delete[] cd2;
+}
+
+// start a thread's partial sums over:
+void ZeroPartial(struct partial *p)
+{
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        p->longsum[k] = 0.;
+        p->latsum[k] = 0.;
+        p->numsum[k] = 0;
+#ifdef WEIGHTED
+        p->weightsum[k] = 0.;
+#endif
+#ifdef GEODESIC
+        p->xsum[k] = p->ysum[k] = p->zsum[k] = 0.;
+#endif
+    }
+    p->changed = 0;
+    p->inertia = 0.;
+    p->distances = 0;
+}
+
+// find the capitals of the n (up to CITYBLOCK) cities starting at city i0, and sum them into the partials
+// (cities before keep keep the capital they have):
+void AssignCities(struct partial *p, int i0, int n, int keep)
+{
+    int capitalnumbers[CITYBLOCK];
+    float mindistances2[CITYBLOCK];
+    if (i0 + n <= keep)
+    {
+        KeepCapitals(i0, n, capitalnumbers, mindistances2);
+        p->distances += n;
+    }
+    else
+    {
+#ifdef BOUNDS
+        BoundedCapitals(i0, n, capitalnumbers, mindistances2, &p->distances);
+#else
+        NearestCapitals(i0, n, capitalnumbers, mindistances2);
+        p->distances += n * NUMCAPITALS;
+#endif
+    }
+
+    for (int i = i0; i < i0 + n; i++)
+    {
+        int capitalnumber = capitalnumbers[i - i0];
+        if (CITYCAPITAL(i) != capitalnumber)
+            p->changed++;
+        CITYCAPITAL(i) = capitalnumber;
+#ifdef WEIGHTED
+        double w = CityWeight[i];
+        p->inertia += w * mindistances2[i - i0];
+        p->longsum[capitalnumber] += w * CITYLONGITUDE(i);
+        p->latsum[capitalnumber] += w * CITYLATITUDE(i);
+        p->weightsum[capitalnumber] += w;
+#else
+        p->inertia += mindistances2[i - i0];
+        p->longsum[capitalnumber] += CITYLONGITUDE(i);
+        p->latsum[capitalnumber] += CITYLATITUDE(i);
+#endif
+        p->numsum[capitalnumber]++;
+#ifdef GEODESIC
+        p->xsum[capitalnumber] += CITYWEIGHT(i) * CityX[i];
+        p->ysum[capitalnumber] += CITYWEIGHT(i) * CityY[i];
+        p->zsum[capitalnumber] += CITYWEIGHT(i) * CityZ[i];
+#endif
+    }
+}
+
+// add a thread's partial sums into the capitals' sums:
+void MergePartial(const struct partial *p, int *changed, double *inertia, long *distances)
+{
+    for (int k = 0; k < NUMCAPITALS; k++)
+    {
+        CapitalLongSum[k] += p->longsum[k];
+        CapitalLatSum[k] += p->latsum[k];
+        CapitalNumSum[k] += p->numsum[k];
+#ifdef WEIGHTED
+        CapitalWeightSum[k] += p->weightsum[k];
+#endif
+#ifdef GEODESIC
+        CapitalXSum[k] += p->xsum[k];
+        CapitalYSum[k] += p->ysum[k];
+        CapitalZSum[k] += p->zsum[k];
+#endif
+    }
+    *changed += p->changed;
+    *inertia += p->inertia;
+    *distances += p->distances;
+}
+
+void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c copies] [-w cities.bin] [-i stride|plusplus|parallel] [-r seed] [-d delta] [-W state.bin] [-S state.bin] [datafile]\n", prog);
+    fprintf(stderr, "\tdatafile       CSV (longitude,latitude,name) or binary point file (default %s)\n", DATAFILE);
+    fprintf(stderr, "\t-c copies      cluster this many jittered copies of the data file, to try large city counts\n");
+    fprintf(stderr, "\t-w cities.bin  write the cities (all the copies) as a binary point file and quit\n");
+    fprintf(stderr, "\t-i seeding     pick the first capitals at uniform intervals through the file (stride, the default),\n");
+    fprintf(stderr, "\t               with k-means++ (plusplus), or with k-means|| (parallel)\n");
+    fprintf(stderr, "\t-r seed        the random number seed for plusplus and parallel (default 0)\n");
+    fprintf(stderr, "\t-d delta       delete and insert the cities the delta file lists (- number, + longitude,latitude,...) first\n");
+    fprintf(stderr, "\t-W state.bin   warm start from a saved clustering of the cities (before the delta), instead of seeding\n");
+    fprintf(stderr, "\t-S state.bin   save the capitals and every city's capital when done\n");
 }
 
 int main(int argc, char *argv[])
@@ -64,92 +1377,421 @@ int main(int argc, char *argv[])
 // #endif
 
     // make sure we have the data correctly:
-    // for( int i = 0; i < NUMCITIES; i++ )
+    // for( int i = 0; i < Points.num; i++ )
     //{
-    // fprintf( stderr, "%3d  %8.2f  %8.2f  %s\n", i, Cities[i].longitude, Cities[i].latitude, Cities[i].name.c_str() );
+    // fprintf( stderr, "%3d  %8.2f  %8.2f  %s\n", i, Points.longitude[i], Points.latitude[i], CityNameOf(i).c_str() );
     //}
     
+    const char *dataFile = DATAFILE;
+    const char *binaryFile = NULL;
+    const char *deltaFile = NULL;
+    const char *warmFile = NULL;
+    const char *saveFile = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            CityCopies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            binaryFile = argv[++i];
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+        {
+            i++;
+            for (Seeding = PARALLEL; Seeding > STRIDE && strcmp(argv[i], SeedingNames[Seeding]) != 0; Seeding--)
+                ;
+            if (strcmp(argv[i], SeedingNames[Seeding]) != 0)
+            {
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            SeedingSeed = (unsigned int)atol(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            deltaFile = argv[++i];
+        else if (strcmp(argv[i], "-W") == 0 && i + 1 < argc)
+            warmFile = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+            saveFile = argv[++i];
+        else if (argv[i][0] != '-')
+            dataFile = argv[i];
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
     omp_set_num_threads(NUMT); // set the number of threads to use in parallelizing the for-loop:`
 
+    if (!LoadPoints(dataFile, NUMT, &Points))
+        return 1;
+
+    // the changes since the last clustering, made to the data file's cities before the copies are made:
+    int oldNumPoints = Points.num;
+    int *oldToNew = NULL;
+    int numInserted = 0;
+    if (deltaFile != NULL)
+    {
+        if (CityCopies != 1)
+        {
+            fprintf(stderr, "A delta (-d) edits the data file's own cities, so it needs -c 1\n");
+            return 1;
+        }
+        struct pointdelta delta;
+        if (!LoadPointDelta(deltaFile, Points.weight != NULL, &delta))
+            return 1;
+        oldToNew = new int[oldNumPoints];
+        double time0 = omp_get_wtime();
+        bool ok = ApplyPointDelta(&Points, &delta, oldToNew);
+        if (ok)
+            fprintf(stderr, "applied '%s' : %d deleted, %d inserted, %d cities now, in %.4lf sec\n", deltaFile,
+                    delta.numDeletes, delta.numInserts, Points.num, omp_get_wtime() - time0);
+        numInserted = delta.numInserts;
+        FreePointDelta(&delta);
+        if (!ok)
+            return 1;
+    }
+
+    if (Points.num < 1 || CityCopies < 1 || (long)Points.num * CityCopies > 2000000000L)
+    {
+        fprintf(stderr, "Cannot cluster %d copies of %d cities\n", CityCopies, Points.num);
+        return 1;
+    }
+    LoadCities();
+
+    if (binaryFile != NULL)
+    {
+        struct points all = {};
+        all.num = NumCities;
+        all.longitude = &CITYLONGITUDE(0);
+        all.latitude = &CITYLATITUDE(0);
+        all.weight = Points.weight != NULL ? CityWeight : NULL;
+#ifdef AOS
+        all.longitude = new float[NumCities];
+        all.latitude = new float[NumCities];
+        for (int i = 0; i < NumCities; i++)
+        {
+            all.longitude[i] = CITYLONGITUDE(i);
+            all.latitude[i] = CITYLATITUDE(i);
+        }
+#endif
+        return WritePointsBinary(binaryFile, &all) ? 0 : 1;
+    }
+
+    for (int k = NUMCAPITALS; k < NUMCAPITALSPADDED; k++)
+    {
+        CapitalLongitude[k] = INFINITY;
+        CapitalLatitude[k] = INFINITY;
+    }
+
     // seed the capitals:
-    // (this is just picking initial capital cities at uniform intervals)
-    for (int k = 0; k < NUMCAPITALS; k++)
+    double seedTime0 = omp_get_wtime();
+    if (warmFile != NULL)
+    {
+        // the saved capitals, and the saved capital of every city that is still here:
+        int oldNumCities = oldNumPoints * CityCopies;
+        int *oldCapitals = new int[oldNumCities];
+        if (!LoadState(warmFile, oldNumCities, oldCapitals))
+            return 1;
+        for (int j = 0; j < oldNumCities; j++)
+        {
+            int i = oldToNew != NULL ? oldToNew[j] : j;
+            if (i >= 0)
+                CITYCAPITAL(i) = oldCapitals[j];
+        }
+        delete[] oldCapitals;
+        WarmKeep = NumCities - numInserted; // the inserted cities are at the end
+        Seeding = WARM;
+        fprintf(stderr, "warm start from '%s' : %d cities keep their capitals, %d are new\n", warmFile, WarmKeep, numInserted);
+#ifdef BOUNDS
+        // no bounds were saved: start them as loose as they can be
+        for (int i = 0; i < WarmKeep; i++)
+        {
+            CityUpper[i] = INFINITY;
+#ifdef HAMERLY
+            CityLower[i] = 0.;
+#else
+            for (int k = 0; k < NUMCAPITALS; k++)
+                CityLowers[(size_t)i * NUMCAPITALS + k] = 0.;
+#endif
+        }
+#endif
+    }
+    else if (Seeding == PLUSPLUS)
+        SeedPlusPlus();
+    else if (Seeding == PARALLEL)
+        SeedParallel();
+    else
+        SeedStride();
+#ifdef GEODESIC
+    ProjectCapitals();
+#endif
+    double seedTime = omp_get_wtime() - seedTime0;
+
+    FILE *profile = fopen(PROFILEFILE, "a");
+    if (profile == NULL)
     {
-        int cityIndex = k * (NUMCITIES - 1) / (NUMCAPITALS - 1);
-        Capitals[k].longitude = Cities[cityIndex].longitude;
-        Capitals[k].latitude = Cities[cityIndex].latitude;
+        fprintf(stderr, "Error opening CSV file!\n");
+        return 1;
     }
 
-    double time0, time1;
+    int iterations = 0;
+    double assignTime = 0.;       // time spent in the assignment loops that compare every city with every capital
+    int assignIterations = 0;     // (all of them but a warm start's first one, which only places the new cities)
+    long totalDistances = 0;      // city-capital distances computed, over all the iterations
+    double solveTime0 = omp_get_wtime();
+#ifdef TILED
+    TuneTiles();
+#endif
     for (int n = 0; n < MAXITERATIONS; n++)
     {
         // reset the summations for the capitals:
         for (int k = 0; k < NUMCAPITALS; k++)
         {
-            Capitals[k].longsum = 0.;
-            Capitals[k].latsum = 0.;
-            Capitals[k].numsum = 0;
+            CapitalLongSum[k] = 0.;
+            CapitalLatSum[k] = 0.;
+            CapitalNumSum[k] = 0;
+#ifdef WEIGHTED
+            CapitalWeightSum[k] = 0.;
+#endif
+#ifdef GEODESIC
+            CapitalXSum[k] = CapitalYSum[k] = CapitalZSum[k] = 0.;
+#endif
         }
+        int changed = 0;
+        double inertia = 0.;
+        long distances = 0;
+        int keep = n == 0 ? WarmKeep : 0; // cities that keep their capital this iteration
 
-        time0 = omp_get_wtime();
+        double time0 = omp_get_wtime();
+#ifdef TILED
+        PrepareTiles();
+#endif
 
+#ifdef CRITICAL
         // the #pragma goes here -- you figure out what it needs to look like:
-#pragma omp parallel for default(none) shared(Cities, Capitals)
-        for (int i = 0; i < NUMCITIES; i++)
+#pragma omp parallel for default(none) shared(NumCities, CITYSTORAGE CITYVECTORS CITYWEIGHTS, CapitalLongSum, CapitalLatSum, CapitalNumSum GEOSUMS WEIGHTSUMS, keep) reduction(+ : changed, inertia, distances)
+        for (int i0 = 0; i0 < NumCities; i0 += CITYBLOCK)
         {
-            int capitalnumber = -1;
-            float mindistance = 1.e+37;
-
-            for (int k = 0; k < NUMCAPITALS; k++)
+            int n = NumCities - i0 < CITYBLOCK ? NumCities - i0 : CITYBLOCK;
+            int capitalnumbers[CITYBLOCK];
+            float mindistances2[CITYBLOCK];
+            if (i0 + n <= keep)
             {
-                float dist = Distance(i, k);
-                if (dist < mindistance)
-                {
-                    capitalnumber = k;
-                    mindistance = dist;
-                    Cities[i].capitalnumber = k;
-                }
+                KeepCapitals(i0, n, capitalnumbers, mindistances2);
+                distances += n;
+            }
+            else
+            {
+                NearestCapitals(i0, n, capitalnumbers, mindistances2);
+                distances += n * NUMCAPITALS;
             }
 
-            int k = Cities[i].capitalnumber;
+            for (int i = i0; i < i0 + n; i++)
+            {
+                if (CITYCAPITAL(i) != capitalnumbers[i - i0])
+                    changed++;
+#ifdef WEIGHTED
+                double w = CityWeight[i];
+                inertia += w * mindistances2[i - i0];
+#else
+                inertia += mindistances2[i - i0];
+#endif
+                CITYCAPITAL(i) = capitalnumbers[i - i0];
+
+                int k = CITYCAPITAL(i);
 // this is here for the same reason as the Trapezoid noteset uses it:
 #pragma omp critical
+                {
+#ifdef WEIGHTED
+                    CapitalLongSum[k] += w * CITYLONGITUDE(i);
+                    CapitalLatSum[k] += w * CITYLATITUDE(i);
+                    CapitalWeightSum[k] += w;
+#else
+                    CapitalLongSum[k] += CITYLONGITUDE(i);
+                    CapitalLatSum[k] += CITYLATITUDE(i);
+#endif
+                    CapitalNumSum[k]++;
+#ifdef GEODESIC
+                    CapitalXSum[k] += CITYWEIGHT(i) * CityX[i];
+                    CapitalYSum[k] += CITYWEIGHT(i) * CityY[i];
+                    CapitalZSum[k] += CITYWEIGHT(i) * CityZ[i];
+#endif
+                }
+            }
+        }
+#else
+#ifdef BOUNDS
+        PrepareBounds();
+#endif
+#ifdef DETERMINISTIC
+        // fixed blocks of cities, each one summed in city order and merged in block order, whatever NUMT is:
+#pragma omp parallel default(none) shared(NumCities, Partials, keep, changed, inertia, distances)
+        {
+            struct partial *p = &Partials[omp_get_thread_num()];
+            int numBlocks = (NumCities + SUMBLOCK - 1) / SUMBLOCK;
+#pragma omp for ordered schedule(static, 1)
+            for (int b = 0; b < numBlocks; b++)
             {
-                Capitals[k].longsum += Cities[i].longitude;
-                Capitals[k].latsum += Cities[i].latitude;
-                Capitals[k].numsum++;
+                ZeroPartial(p);
+                int end = (b + 1) * SUMBLOCK < NumCities ? (b + 1) * SUMBLOCK : NumCities;
+                for (int i0 = b * SUMBLOCK; i0 < end; i0 += CITYBLOCK)
+                    AssignCities(p, i0, end - i0 < CITYBLOCK ? end - i0 : CITYBLOCK, keep);
+#pragma omp ordered
+                MergePartial(p, &changed, &inertia, &distances);
             }
         }
-        time1 = omp_get_wtime();
+#else
+        // every thread sums into its own partials, no locking:
+#pragma omp parallel default(none) shared(NumCities, Partials, keep)
+        {
+            struct partial *p = &Partials[omp_get_thread_num()];
+            ZeroPartial(p);
+#pragma omp for
+            for (int i0 = 0; i0 < NumCities; i0 += CITYBLOCK)
+                AssignCities(p, i0, NumCities - i0 < CITYBLOCK ? NumCities - i0 : CITYBLOCK, keep);
+        }
 
-        // get the average longitude and latitude for each capital:
+        // merge the partial sums, once per iteration:
+        for (int t = 0; t < NUMT; t++)
+            MergePartial(&Partials[t], &changed, &inertia, &distances);
+#endif
+#endif
+        double time1 = omp_get_wtime();
+        iterations++;
+        if (keep == 0)
+        {
+            assignTime += time1 - time0;
+            assignIterations++;
+        }
+        totalDistances += distances;
+
+        // get the (weighted) average longitude and latitude for each capital, and how far the capitals moved:
+        float maxShift = 0.;
         for (int k = 0; k < NUMCAPITALS; k++)
         {
-            Capitals[k].longitude = Capitals[k].longsum / Capitals[k].numsum;
-            Capitals[k].latitude = Capitals[k].latsum / Capitals[k].numsum;
+            CapitalShift[k] = 0.;
+            if (CapitalNumSum[k] == 0) // nobody likes this capital, leave it where it is
+                continue;
+#ifdef GEODESIC
+            // the spherical centroid: the direction of the summed unit vectors, put back on the sphere
+            // (shift is the chord it moved, in the degrees-of-arc units the planar shifts use):
+            double norm = sqrt(CapitalXSum[k] * CapitalXSum[k] + CapitalYSum[k] * CapitalYSum[k] + CapitalZSum[k] * CapitalZSum[k]);
+            if (norm == 0.)
+                continue;
+            float x = (float)(CapitalXSum[k] / norm);
+            float y = (float)(CapitalYSum[k] / norm);
+            float z = (float)(CapitalZSum[k] / norm);
+            float dx = x - CapitalX[k];
+            float dy = y - CapitalY[k];
+            float dz = z - CapitalZ[k];
+            float shift = sqrtf(dx * dx + dy * dy + dz * dz) * (float)(180. / M_PI);
+            if (shift > maxShift)
+                maxShift = shift;
+            CapitalShift[k] = shift;
+            CapitalX[k] = x;
+            CapitalY[k] = y;
+            CapitalZ[k] = z;
+            CapitalLongitude[k] = atan2f(y, x) * (float)(180. / M_PI);
+            CapitalLatitude[k] = asinf(fminf(fmaxf(z, -1.f), 1.f)) * (float)(180. / M_PI);
+#else
+#ifdef WEIGHTED
+            if (CapitalWeightSum[k] == 0.) // only weightless cities like this capital
+                continue;
+            float longitude = (float)(CapitalLongSum[k] / CapitalWeightSum[k]);
+            float latitude = (float)(CapitalLatSum[k] / CapitalWeightSum[k]);
+#else
+            float longitude = CapitalLongSum[k] / CapitalNumSum[k];
+            float latitude = CapitalLatSum[k] / CapitalNumSum[k];
+#endif
+            float dx = longitude - CapitalLongitude[k];
+            float dy = latitude - CapitalLatitude[k];
+            float shift = sqrtf(dx * dx + dy * dy);
+            if (shift > maxShift)
+                maxShift = shift;
+            CapitalShift[k] = shift;
+            CapitalLongitude[k] = longitude;
+            CapitalLatitude[k] = latitude;
+#endif
         }
+
+        fprintf(profile, "%2d, %4d, %4d, %3d, %10.6lf, %8d, %14.4lf, %10.6f, %8.3lf\n",
+                NUMT, NumCities, NUMCAPITALS, n, time1 - time0, changed, inertia, maxShift,
+                (double)NumCities * (double)NUMCAPITALS / (time1 - time0) / 1000000.);
+
+        // (a warm start's first iteration only placed the new cities, the refinement is still to come)
+        if (keep == 0 && (changed == 0 || maxShift < TOLERANCE))
+            break;
     }
+    double timeToSolution = omp_get_wtime() - solveTime0;
+    fclose(profile);
 
-    double megaCityCapitalsPerSecond = (double)NUMCITIES * (double)NUMCAPITALS / (time1 - time0) / 1000000.;
+    // the average assignment throughput over all the iterations (not just the last one)
+    // that compare every city with every capital:
+    double megaCityCapitalsPerSecond = (double)NumCities * (double)NUMCAPITALS * (double)assignIterations / assignTime / 1000000.;
 
-    // figure out what actual city is closest to each capital:
-    // this is the extra credit:
-    for (int k = 0; k < NUMCAPITALS; k++)
+    // how many of the city-capital distances the bounds made unnecessary:
+    double skippedPercent = 100. * (1. - (double)totalDistances / ((double)NumCities * (double)NUMCAPITALS * (double)iterations));
+
+    // the inertia of the final capitals (the one in the profile is from before the last capital update):
+    double finalInertia = 0.;
+#ifdef DETERMINISTIC
+    // summed in the same fixed SUMBLOCK blocks as the capitals, added up in block order, whatever NUMT is:
+    int numInertiaBlocks = (NumCities + SUMBLOCK - 1) / SUMBLOCK;
+    double *blockInertia = new double[numInertiaBlocks];
+#pragma omp parallel for default(none) shared(NumCities, CITYSTORAGE CITYWEIGHTS, numInertiaBlocks, blockInertia)
+    for (int b = 0; b < numInertiaBlocks; b++)
     {
-        float mindist = 1.e+37;
-        int minindex = -1;
-        for (int i = 0; i < NUMCITIES; i++)
+        double sum = 0.;
+        int end = (b + 1) * SUMBLOCK < NumCities ? (b + 1) * SUMBLOCK : NumCities;
+        for (int i = b * SUMBLOCK; i < end; i++)
         {
-            float dist = Distance(i, k);
-            if (dist < mindist)
-            {
-                mindist = dist;
-                minindex = i;
-            }
+            float d = Distance(i, CITYCAPITAL(i));
+            sum += CITYWEIGHT(i) * (d * d);
         }
+        blockInertia[b] = sum;
+    }
+    for (int b = 0; b < numInertiaBlocks; b++)
+        finalInertia += blockInertia[b];
+    delete[] blockInertia;
+#else
+#pragma omp parallel for default(none) shared(NumCities, CITYSTORAGE CITYWEIGHTS) reduction(+ : finalInertia)
+    for (int i = 0; i < NumCities; i++)
+    {
+        float d = Distance(i, CITYCAPITAL(i));
+        finalInertia += CITYWEIGHT(i) * (d * d);
+    }
+#endif
 
-        Capitals[k].name = Cities[minindex].name;
+    // figure out what actual city is closest to each capital:
+    // this is the extra credit:
+    // (a k-d tree over the cities answers all the capitals' queries at once, instead of scanning every city for each)
+    double nameTime0 = omp_get_wtime();
+#ifdef AOS
+    float *cityLongitudes = new float[NumCities];
+    float *cityLatitudes = new float[NumCities];
+    for (int i = 0; i < NumCities; i++)
+    {
+        cityLongitudes[i] = CITYLONGITUDE(i);
+        cityLatitudes[i] = CITYLATITUDE(i);
     }
+#else
+    float *cityLongitudes = CityLongitude;
+    float *cityLatitudes = CityLatitude;
+#endif
+    struct kdtree cityTree;
+    BuildKdTree(cityLongitudes, cityLatitudes, NumCities, &cityTree);
+    int nearestCities[NUMCAPITALS];
+    float nearestDistances2[NUMCAPITALS];
+    KdNearestBatch(&cityTree, CapitalLongitude, CapitalLatitude, NUMCAPITALS, nearestCities, nearestDistances2);
+    for (int k = 0; k < NUMCAPITALS; k++)
+        CapitalName[k] = CITYNAME(nearestCities[k]);
+    FreeKdTree(&cityTree);
+#ifdef AOS
+    delete[] cityLongitudes;
+    delete[] cityLatitudes;
+#endif
+    fprintf(stderr, "named the capitals in %.6lf sec\n", omp_get_wtime() - nameTime0);
 
     // print the longitude-latitude of each new capital city:
     // you only need to do this once per some number of NUMCAPITALS -- do it for the 1-thread version:
@@ -164,33 +1806,40 @@ int main(int argc, char *argv[])
         }
         for (int k = 0; k < NUMCAPITALS; k++)
         {
-            // fprintf( stderr, "\t%3d:  %8.2f , %8.2f\n", k, Capitals[k].longitude, Capitals[k].latitude );
+            // fprintf( stderr, "\t%3d:  %8.2f , %8.2f\n", k, CapitalLongitude[k], CapitalLatitude[k] );
 
             // if you did the extra credit, use this fprintf instead:
             // fprintf(stderr, "%s\n", "extra credit");
-            // fprintf(stderr, "\t%3d:  %8.2f, %8.2f, %s\n", k, Capitals[k].longitude, Capitals[k].latitude, Capitals[k].name.c_str());
-            fprintf(file_pointer_extra_credit, "\t%3d,  %8.2f, %8.2f, %s\n", k, Capitals[k].longitude, Capitals[k].latitude, Capitals[k].name.c_str());
+            // fprintf(stderr, "\t%3d:  %8.2f, %8.2f, %s\n", k, CapitalLongitude[k], CapitalLatitude[k], CapitalName[k].c_str());
+            fprintf(file_pointer_extra_credit, "\t%3d,  %8.2f, %8.2f, %s\n", k, CapitalLongitude[k], CapitalLatitude[k], CapitalName[k].c_str());
         }
     }
 #ifdef CSV
     // fprintf(stderr, "%s\n", "CSV");
-    // fprintf(stderr, "%2d , %4d , %4d , %8.3lf:\n", NUMT, NUMCITIES, NUMCAPITALS, megaCityCapitalsPerSecond);
+    // fprintf(stderr, "%2d , %4d , %4d , %8.3lf:\n", NUMT, NumCities, NUMCAPITALS, megaCityCapitalsPerSecond);
 
     FILE *file_pointer;
-    file_pointer = fopen("output/output.csv", "a");
+    file_pointer = fopen(CSVFILE, "a");
     if (file_pointer == NULL)
     {
         fprintf(stderr, "Error opening CSV file!\n");
         return 1;
     }
     // Write data to the CSV file
-    fprintf(file_pointer, "%2d, %4d, %4d, %8.3lf\n", NUMT, NUMCITIES, NUMCAPITALS, megaCityCapitalsPerSecond);
+    fprintf(file_pointer, "%2d, %4d, %4d, %8.3lf, %3d, %10.6lf, %6.2lf, %10.6lf, %14.4lf\n", NUMT, NumCities, NUMCAPITALS, megaCityCapitalsPerSecond,
+            iterations, timeToSolution, skippedPercent, seedTime, finalInertia);
 
     // Close the CSV file
     fclose(file_pointer);
 
 #else
-    fprintf(stderr, "%2d threads : %4d cities ; %4d capitals; megatrials/sec = %8.3lf\n",
-            NUMT, NUMCITIES, NUMCAPITALS, megaCityCapitalsPerSecond);
+    fprintf(stderr, "%2d threads : %4d cities ; %4d capitals; megatrials/sec = %8.3lf ; %3d iterations ; %10.6lf sec to solution ; %6.2lf%% distances skipped ; %s seeding in %10.6lf sec ; inertia = %14.4lf\n",
+            NUMT, NumCities, NUMCAPITALS, megaCityCapitalsPerSecond, iterations, timeToSolution, skippedPercent,
+            SeedingNames[Seeding], seedTime, finalInertia);
 #endif
+
+    if (saveFile != NULL && !SaveState(saveFile))
+        return 1;
+
+    FreePoints(&Points);
 }
\ No newline at end of file
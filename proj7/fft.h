@@ -0,0 +1,151 @@
+#ifndef FFT_H
+#define FFT_H
+
+// a small in-place radix-2 FFT, enough to do autocorrelations with (Wiener-Khinchin):
+// the autocorrelation is the inverse transform of the power spectrum, so it costs O(N log N) instead of O(N x shifts)
+// all the sizes must be powers of 2
+
+#include <math.h>
+
+// is n a power of 2?
+
+static inline bool IsPowerOf2(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// the smallest power of 2 that is >= n:
+
+static inline int NextPowerOf2(int n)
+{
+    int p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+// transform n complex numbers, stored re,im,re,im,... in z[2*n]
+// sign = -1 is the forward transform, sign = +1 the inverse one (without the 1/n):
+
+static void ComplexFFT(double *z, int n, int sign)
+{
+    // put the numbers in bit-reversed order:
+    for (int i = 0, j = 0; i < n; i++)
+    {
+        if (i < j)
+        {
+            double t;
+            t = z[2 * i], z[2 * i] = z[2 * j], z[2 * j] = t;
+            t = z[2 * i + 1], z[2 * i + 1] = z[2 * j + 1], z[2 * j + 1] = t;
+        }
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j |= bit;
+    }
+
+    // the butterflies, twice as wide each stage (the twiddles come from a recurrence, not a sin/cos each):
+    for (int half = 1; half < n; half <<= 1)
+    {
+        double theta = sign * M_PI / half;
+        double s = sin(0.5 * theta);
+        double wpr = -2. * s * s; // cos(theta) - 1
+        double wpi = sin(theta);
+        double wr = 1.;
+        double wi = 0.;
+        for (int k = 0; k < half; k++)
+        {
+            for (int i = k; i < n; i += 2 * half)
+            {
+                int j = i + half;
+                double tr = wr * z[2 * j] - wi * z[2 * j + 1];
+                double ti = wr * z[2 * j + 1] + wi * z[2 * j];
+                z[2 * j] = z[2 * i] - tr;
+                z[2 * j + 1] = z[2 * i + 1] - ti;
+                z[2 * i] += tr;
+                z[2 * i + 1] += ti;
+            }
+            double t = wr;
+            wr += t * wpr - wi * wpi;
+            wi += wi * wpr + t * wpi;
+        }
+    }
+}
+
+// transform n real numbers in x[n] into the first half of their spectrum, in place, as a complex FFT of n/2:
+// x[0] = X[0], x[1] = X[n/2] (both are real), then x[2k],x[2k+1] = re,im of X[k] for 0 < k < n/2
+
+static void RealFFT(double *x, int n)
+{
+    int h = n / 2;
+    ComplexFFT(x, h, -1); // the evens are the real parts, the odds the imaginary parts
+
+    // untangle the evens' and the odds' spectra, E and O, and combine them: X[k] = E[k] + w^k O[k]
+    double x0 = x[0];
+    x[0] = x0 + x[1];
+    x[1] = x0 - x[1];
+    double theta = -2. * M_PI / n;
+    double sh = sin(0.5 * theta);
+    double wpr = -2. * sh * sh;
+    double wpi = sin(theta);
+    double wr = 1.;
+    double wi = 0.;
+    for (int k = 1; k <= h / 2; k++)
+    {
+        double t = wr;
+        wr += t * wpr - wi * wpi;
+        wi += wi * wpr + t * wpi;
+        int m = h - k;
+        double er = 0.5 * (x[2 * k] + x[2 * m]);
+        double ei = 0.5 * (x[2 * k + 1] - x[2 * m + 1]);
+        double or_ = 0.5 * (x[2 * k + 1] + x[2 * m + 1]);
+        double oi = -0.5 * (x[2 * k] - x[2 * m]);
+        double tr = wr * or_ - wi * oi;
+        double ti = wr * oi + wi * or_;
+        x[2 * k] = er + tr;
+        x[2 * k + 1] = ei + ti;
+        x[2 * m] = er - tr; // X[h-k] = conj(E[k] - w^k O[k])
+        x[2 * m + 1] = -(ei - ti);
+    }
+}
+
+// undo RealFFT( ), including the 1/n:
+
+static void InverseRealFFT(double *x, int n)
+{
+    int h = n / 2;
+
+    // E[k] = (X[k] + conj(X[h-k]))/2, O[k] = (X[k] - conj(X[h-k])) / (2 w^k), then Z[k] = E[k] + i O[k]
+    double x0 = x[0];
+    x[0] = 0.5 * (x0 + x[1]);
+    x[1] = 0.5 * (x0 - x[1]);
+    double theta = 2. * M_PI / n;
+    double sh = sin(0.5 * theta);
+    double wpr = -2. * sh * sh;
+    double wpi = sin(theta);
+    double wr = 1.;
+    double wi = 0.;
+    for (int k = 1; k <= h / 2; k++)
+    {
+        double t = wr;
+        wr += t * wpr - wi * wpi;
+        wi += wi * wpr + t * wpi;
+        int m = h - k;
+        double er = 0.5 * (x[2 * k] + x[2 * m]);
+        double ei = 0.5 * (x[2 * k + 1] - x[2 * m + 1]);
+        double dr = 0.5 * (x[2 * k] - x[2 * m]);
+        double di = 0.5 * (x[2 * k + 1] + x[2 * m + 1]);
+        double or_ = dr * wr - di * wi;
+        double oi = dr * wi + di * wr;
+        x[2 * k] = er - oi;
+        x[2 * k + 1] = ei + or_;
+        x[2 * m] = er + oi; // Z[h-k] = conj(E[k]) + i conj(O[k])
+        x[2 * m + 1] = -ei + or_;
+    }
+
+    ComplexFFT(x, h, +1);
+    for (int i = 0; i < n; i++)
+        x[i] /= h;
+}
+
+#endif
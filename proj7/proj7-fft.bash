@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# direct vs. FFT autocorrelation, and which one CROSSOVER picks, for more and more shifts:
+# each run appends engine,processors,threads,shifts,elements,MegaAutoCorrelationsPerSecond to engine-performance.csv,
+# and the plot files are kept to check that both engines get the same sums
+
+rm -f engine-performance.csv
+echo "engine,processors,threads,shifts,elements,MegaAutoCorrelationsPerSecond" > engine-performance.csv
+
+for s in 16 32 64 128 256 1024 4096
+    do
+        for b in 1 2 4
+            do
+                for e in DIRECT FFT CROSSOVER
+                    do
+                        mpic++ -O3 -D$e -DMAXSHIFTS=$s proj7.cpp -o proj7-engine -lm
+                        mpirun --oversubscribe -np $b ./proj7-engine
+                        cp plot.csv plot-$e-$s-$b.csv
+                    done
+            done
+        # the biggest relative difference between the direct (float) and FFT (double) sums:
+        paste -d, plot-DIRECT-$s-1.csv plot-FFT-$s-1.csv | awk -F, -v s=$s \
+            '{ d = ($2 - $4) / $4; if (d < 0) d = -d; if (d > m) m = d } END { print s " shifts: direct vs. FFT differ by at most " m }'
+    done
@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# hybrid MPI + OpenMP + SIMD autocorrelation on one host:
+# every processors x threads combination, with the plain one-core-per-processor loop first to compare against
+
+rm -f hybrid-performance.csv
+echo "processors,threads,elements,MegaAutoCorrelationsPerSecond" > hybrid-performance.csv
+
+for b in 1 2 4
+    do
+        mpic++ -O3 proj7.cpp -o proj7 -lm
+        mpirun --oversubscribe -np $b ./proj7
+        for t in 1 2 4 8
+            do
+                mpic++ -O3 -fopenmp -DHYBRID -DNUMT=$t proj7.cpp -o proj7-hybrid -lm
+                mpirun --oversubscribe -np $b ./proj7-hybrid
+            done
+    done
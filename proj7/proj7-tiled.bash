@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# the plain direct loop vs. the tiled, register-blocked one, with and without HYBRID's threads:
+# each run appends engine,processors,threads,shifts,elements,MegaAutoCorrelationsPerSecond to engine-performance.csv,
+# and the tiled runs print a model (an estimate, not a measurement) of how much less they read from outside L1
+
+rm -f engine-performance.csv
+echo "engine,processors,threads,shifts,elements,MegaAutoCorrelationsPerSecond" > engine-performance.csv
+
+for b in 1 2 4
+    do
+        mpic++ -O3 -march=native -DDIRECT proj7.cpp -o proj7-direct -lm
+        mpirun --oversubscribe -np $b ./proj7-direct
+        mpic++ -O3 -march=native -DDIRECT -DTILED proj7.cpp -o proj7-tiled -lm
+        mpirun --oversubscribe -np $b ./proj7-tiled
+        for t in 2 4
+            do
+                mpic++ -O3 -march=native -fopenmp -DHYBRID -DNUMT=$t -DDIRECT proj7.cpp -o proj7-direct -lm
+                mpirun --oversubscribe -np $b ./proj7-direct
+                mpic++ -O3 -march=native -fopenmp -DHYBRID -DNUMT=$t -DDIRECT -DTILED proj7.cpp -o proj7-tiled -lm
+                mpirun --oversubscribe -np $b ./proj7-tiled
+            done
+    done
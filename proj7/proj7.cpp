@@ -1,7 +1,10 @@
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <mpi.h>
 
+#include "fft.h"
+
 // which node is in charge?
 
 #define THEBOSS 0
@@ -26,7 +29,9 @@
 
 // only do this many shifts, not all NUMELEMENTS of them (this is enough to uncover the secret sine wave):
 
+#ifndef MAXSHIFTS
 #define MAXSHIFTS 1024
+#endif
 
 // how many autocorrelation sums to plot:
 
@@ -38,6 +43,101 @@
 #define BINARY
 // #define ASCII
 
+// define HYBRID to have every processor split its shifts among NUMT OpenMP threads, each one doing its sums
+// with SIMD instructions, instead of one core doing them all one multiply-add at a time
+// (compile with -fopenmp, and -O3 so the sums are vectorized):
+
+// #define HYBRID
+
+// how many threads each processor uses when HYBRID:
+
+#ifndef NUMT
+#define NUMT 1
+#endif
+
+// where HYBRID appends its performance, one line per processors x threads run:
+
+#define CSVHYBRIDFILE (char *)"hybrid-performance.csv"
+
+// define TILED to do the direct sums a tile of the signal at a time, SHIFTBLOCK shifts at a time:
+// the plain loop streams the whole signal through the cache once per shift (MAXSHIFTS passes over PPSize floats),
+// the tiled one reads each TILESIZE-long tile (plus the MAXSHIFTS after it) from memory once, and then does every
+// shift with it while it sits in the L1 cache, keeping SHIFTBLOCK shifts' sums in SIMD registers, so each vector
+// of the signal it loads is used for SHIFTBLOCK multiply-adds (with HYBRID, the threads split the tiles):
+
+// #define TILED
+
+#ifndef TILESIZE
+#define TILESIZE 4096 // 16 KB, and the MAXSHIFTS after it, fit in the L1 cache
+#endif
+
+#ifndef SHIFTBLOCK
+#define SHIFTBLOCK 8
+#endif
+
+#if defined(TILED) && MAXSHIFTS % SHIFTBLOCK != 0
+#error "MAXSHIFTS must be a multiple of SHIFTBLOCK"
+#endif
+
+// SIMD width of the tiled kernel, whatever the compiler was told the cpu has (-march=native, -mavx, ...):
+#if defined(__AVX512F__)
+#define SIMDWIDTH 16
+#elif defined(__AVX__)
+#define SIMDWIDTH 8
+#else
+#define SIMDWIDTH 4 // SSE, every x86-64 has it
+#endif
+
+typedef float vfloat __attribute__((vector_size(4 * SIMDWIDTH)));
+
+// pick the autocorrelation engine explicitly, and append its performance to CSVENGINEFILE
+// (with none of these, the sums are done directly, the way they always have been):
+// DIRECT does the sums directly, O(elements x shifts)
+// FFT uses the Wiener-Khinchin theorem instead: each processor cuts its signal into chunks of FFTSIZE-MAXSHIFTS,
+//     zero-pads each chunk, and the chunk plus the MAXSHIFTS after it, out to FFTSIZE, adds up the products of their
+//     spectra, and does one inverse FFT at the end, O(elements x log(FFTSIZE)) -- the processors' chunks are
+//     independent, so the distributed version is the same scatter and gather as the direct one
+//     (and with HYBRID, the threads split the chunks)
+// CROSSOVER has each processor pick DIRECT or FFT, whichever the cost model below says is cheaper for
+//     its number of elements and MAXSHIFTS
+// (pick one, not more)
+
+// #define DIRECT
+// #define FFT
+// #define CROSSOVER
+
+#if defined(DIRECT) + defined(FFT) + defined(CROSSOVER) > 1
+#error "Pick only one of DIRECT, FFT, and CROSSOVER"
+#endif
+
+// how big the FFTs are (a power of 2 bigger than MAXSHIFTS): 0 means FFTCHUNKS x MAXSHIFTS, rounded up to a power of 2,
+// but no bigger than it takes to do the whole signal in one chunk:
+
+#ifndef FFTSIZE
+#define FFTSIZE 0
+#endif
+
+#define FFTCHUNKS 8
+
+// the cost model: a direct autocorrelation costs elements x shifts multiply-adds, an FFT one costs
+// FFTCOST x FFTSIZE x log2(FFTSIZE) multiply-adds' worth of time per chunk (measured with proj7-fft.bash:
+// the FFT wins from about 32 shifts on, about 128 when HYBRID has vectorized the direct sums, and about 384 when
+// TILED has):
+
+#ifndef FFTCOST
+#if defined(TILED)
+#define FFTCOST 27.0
+#elif defined(HYBRID)
+#define FFTCOST 9.0
+#else
+#define FFTCOST 2.5
+#endif
+#endif
+
+// where DIRECT, FFT, and CROSSOVER append their performance:
+
+#define CSVENGINEFILE (char *)"engine-performance.csv"
+
 // print debugging messages?
 
 #define DEBUG true
@@ -50,10 +150,14 @@ int NumCpus;      // total # of cpus involved
 float *PPSums;    // per-processor autocorrelation sums
 float *PPSignal;  // per-processor local array to hold the sub-signal
 int PPSize;       // per-processor local array size
+bool UseFft;      // does this processor do its autocorrelation with FFTs?
+int FftSize;      // how big its FFTs are
 
 // function prototype:
 
 void DoOneLocalAutocorrelation(int);
+void DoOneLocalFftAutocorrelation(int);
+void DoOneLocalTiledAutocorrelation(int);
 
 int main(int argc, char *argv[])
 {
@@ -74,6 +178,38 @@ int main(int argc, char *argv[])
     PPSignal = new float[PPSize + MAXSHIFTS]; // per-processor local signal
     PPSums = new float[MAXSHIFTS];            // per-processor local sums of the products
 
+    // pick the engine:
+
+    FftSize = FFTSIZE;
+    if (FftSize == 0)
+    {
+        FftSize = NextPowerOf2(FFTCHUNKS * MAXSHIFTS);
+        if (FftSize > NextPowerOf2(PPSize + MAXSHIFTS))
+            FftSize = NextPowerOf2(PPSize + MAXSHIFTS);
+    }
+    if (!IsPowerOf2(FftSize) || FftSize <= MAXSHIFTS)
+    {
+        if (me == THEBOSS)
+            fprintf(stderr, "FFTSIZE must be a power of 2 bigger than MAXSHIFTS = %d\n", MAXSHIFTS);
+        MPI_Finalize();
+        return -1;
+    }
+#if defined(FFT)
+    UseFft = true;
+#elif defined(CROSSOVER)
+    {
+        int chunks = (PPSize + FftSize - MAXSHIFTS - 1) / (FftSize - MAXSHIFTS);
+        double directCost = (double)PPSize * (double)MAXSHIFTS;
+        double fftCost = FFTCOST * (double)chunks * (double)FftSize * log2((double)FftSize);
+        UseFft = fftCost < directCost;
+        if (DEBUG && me == THEBOSS)
+            fprintf(stderr, "Direct cost = %.3le, FFT cost = %.3le (%d chunks of %d), so %s\n",
+                    directCost, fftCost, chunks, FftSize, UseFft ? "FFT" : "direct");
+    }
+#else
+    UseFft = false;
+#endif
+
     // read the BigSignal array:
 
     if (me == THEBOSS) // this is the big-data-owner
@@ -197,8 +333,44 @@ int main(int argc, char *argv[])
     {
         double seconds = time1 - time0;
         double performance = (double)MAXSHIFTS * (double)NUMELEMENTS / seconds / 1000000.; // mega-elements computed per second
+#ifdef HYBRID
+        fprintf(stderr, "%3d processors, %3d threads, %10d elements, %9.2lf mega-autocorrelations computed per second\n",
+                NumCpus, NUMT, NUMELEMENTS, performance);
+
+        // same as performance.csv, with the threads per processor:
+        FILE *fp = fopen(CSVHYBRIDFILE, "a");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Cannot write to performance file '%s'\n", CSVHYBRIDFILE);
+        }
+        else
+        {
+            fprintf(fp, "%d,%d,%d,%.2lf\n", NumCpus, NUMT, NUMELEMENTS, performance);
+            fclose(fp);
+        }
+#else
         fprintf(stderr, "%3d processors, %10d elements, %9.2lf mega-autocorrelations computed per second\n",
                 NumCpus, NUMELEMENTS, performance);
+#endif
+
+#if defined(DIRECT) || defined(FFT) || defined(CROSSOVER)
+        // the FFT does not really compute every product, but this is how fast it gets the same sums:
+        FILE *efp = fopen(CSVENGINEFILE, "a");
+        if (efp == NULL)
+        {
+            fprintf(stderr, "Cannot write to performance file '%s'\n", CSVENGINEFILE);
+        }
+        else
+        {
+#ifdef TILED
+            const char *engine = UseFft ? "fft" : "tiled";
+#else
+            const char *engine = UseFft ? "fft" : "direct";
+#endif
+            fprintf(efp, "%s,%d,%d,%d,%d,%.2lf\n", engine, NumCpus, NUMT, MAXSHIFTS, NUMELEMENTS, performance);
+            fclose(efp);
+        }
+#endif
     }
 
     // write the file to be plotted to look for the secret sine wave:
@@ -212,7 +384,7 @@ int main(int argc, char *argv[])
         }
         else
         {
-            for (int s = 1; s < MAXPLOT; s++) // BigSums[0] is huge -- don't use it
+            for (int s = 1; s < MAXPLOT && s < MAXSHIFTS; s++) // BigSums[0] is huge -- don't use it
             {
                 fprintf(fp, "%6d , %10.2f\n", s, BigSums[s]);
             }
@@ -235,6 +407,32 @@ void DoOneLocalAutocorrelation(int me)
     if (DEBUG)
         fprintf(stderr, "Node %3d entered DoOneLocalAutocorrelation( )\n", me);
 
+    if (UseFft)
+    {
+        DoOneLocalFftAutocorrelation(me);
+        return;
+    }
+
+#ifdef TILED
+    DoOneLocalTiledAutocorrelation(me);
+    return;
+#endif
+
+#ifdef HYBRID
+    // the shifts are independent, so the threads split them, and each sum is vectorized
+    // (several partial sums, one per SIMD lane, added up at the end -- so the last digits can differ):
+#pragma omp parallel for num_threads(NUMT) schedule(static)
+    for (int s = 0; s < MAXSHIFTS; s++)
+    {
+        float sum = 0.;
+#pragma omp simd reduction(+ : sum)
+        for (int i = 0; i < PPSize; i++)
+        {
+            sum += PPSignal[i] * PPSignal[i + s];
+        }
+        PPSums[s] = sum;
+    }
+#else
     for (int s = 0; s < MAXSHIFTS; s++)
     {
         float sum = 0.;
@@ -244,4 +442,132 @@ void DoOneLocalAutocorrelation(int me)
         }
         PPSums[s] = sum;
     }
+#endif
+}
+
+// the same sums, with FFTs:
+// sum over i of PPSignal[i]*PPSignal[i+s] is the cross-correlation of the signal with itself plus MAXSHIFTS more,
+// and it adds up chunk by chunk, so add up every chunk's cross-power spectrum and do one inverse FFT of the total
+// (everything is in double, so this is closer to the exact sums than the direct float ones)
+
+void DoOneLocalFftAutocorrelation(int me)
+{
+    int chunk = FftSize - MAXSHIFTS; // a chunk plus its MAXSHIFTS still fits with no wrap-around
+    int numChunks = (PPSize + chunk - 1) / chunk;
+    double *spectrum = new double[FftSize]; // the sum of the cross-power spectra, packed the way RealFFT( ) does
+    for (int k = 0; k < FftSize; k++)
+        spectrum[k] = 0.;
+
+    if (DEBUG)
+        fprintf(stderr, "Node %3d is doing %d FFT chunks of %d\n", me, numChunks, FftSize);
+
+#ifdef HYBRID
+#pragma omp parallel num_threads(NUMT)
+#endif
+    {
+        double *a = new double[FftSize]; // the chunk
+        double *b = new double[FftSize]; // the chunk and the MAXSHIFTS after it
+
+#ifdef HYBRID
+#pragma omp for schedule(static) reduction(+ : spectrum[:FftSize])
+#endif
+        for (int c = 0; c < numChunks; c++)
+        {
+            int first = c * chunk;
+            int n = PPSize - first < chunk ? PPSize - first : chunk;
+            for (int i = 0; i < FftSize; i++)
+            {
+                a[i] = i < n ? PPSignal[first + i] : 0.;
+                b[i] = i < n + MAXSHIFTS ? PPSignal[first + i] : 0.;
+            }
+            RealFFT(a, FftSize);
+            RealFFT(b, FftSize);
+
+            // conj(A) x B (X[0] and X[FftSize/2] are real, and packed into [0] and [1]):
+            spectrum[0] += a[0] * b[0];
+            spectrum[1] += a[1] * b[1];
+            for (int k = 2; k < FftSize; k += 2)
+            {
+                spectrum[k] += a[k] * b[k] + a[k + 1] * b[k + 1];
+                spectrum[k + 1] += a[k] * b[k + 1] - a[k + 1] * b[k];
+            }
+        }
+
+        delete[] a;
+        delete[] b;
+    }
+
+    InverseRealFFT(spectrum, FftSize);
+    for (int s = 0; s < MAXSHIFTS; s++)
+    {
+        PPSums[s] = (float)spectrum[s];
+    }
+    delete[] spectrum;
+}
+
+// the same sums, a tile at a time:
+// for each tile, for each block of SHIFTBLOCK shifts, the SIMDWIDTH products of one vector of the tile with the
+// SHIFTBLOCK shifted vectors go into SHIFTBLOCK vector sums; each tile's sums are added up in double
+
+void DoOneLocalTiledAutocorrelation(int me)
+{
+    double *sums = new double[MAXSHIFTS];
+    for (int s = 0; s < MAXSHIFTS; s++)
+        sums[s] = 0.;
+
+    if (DEBUG)
+    {
+        // a model of how many bytes come from outside the L1 cache, not a measurement (it assumes the plain loop
+        // gets no reuse from the cache between shifts, and the tiled one all of it within a tile):
+        // every shift's pass over the signal vs. every tile once
+        int numTiles = (PPSize + TILESIZE - 1) / TILESIZE;
+        double plainBytes = (double)MAXSHIFTS * (double)PPSize * sizeof(float);
+        double tiledBytes = (double)numTiles * (double)(TILESIZE + MAXSHIFTS) * sizeof(float);
+        fprintf(stderr, "Node %3d modeled L1 misses: %.2lf MB instead of %.2lf MB (%.0lfx less, estimated)\n",
+                me, tiledBytes / 1000000., plainBytes / 1000000., plainBytes / tiledBytes);
+    }
+
+#ifdef HYBRID
+#pragma omp parallel for num_threads(NUMT) schedule(static) reduction(+ : sums[:MAXSHIFTS])
+#endif
+    for (int t0 = 0; t0 < PPSize; t0 += TILESIZE)
+    {
+        int n = PPSize - t0 < TILESIZE ? PPSize - t0 : TILESIZE;
+        int nv = n - n % SIMDWIDTH; // the rest are done one at a time
+        const float *tile = &PPSignal[t0];
+
+        for (int s0 = 0; s0 < MAXSHIFTS; s0 += SHIFTBLOCK)
+        {
+            vfloat acc[SHIFTBLOCK];
+            for (int j = 0; j < SHIFTBLOCK; j++)
+                acc[j] = (vfloat){};
+
+            for (int i = 0; i < nv; i += SIMDWIDTH)
+            {
+                vfloat x, y;
+                memcpy(&x, &tile[i], sizeof(vfloat)); // (the shifted ones are never aligned)
+                for (int j = 0; j < SHIFTBLOCK; j++)
+                {
+                    memcpy(&y, &tile[i + s0 + j], sizeof(vfloat));
+                    acc[j] += x * y;
+                }
+            }
+
+            for (int j = 0; j < SHIFTBLOCK; j++)
+            {
+                float sum = 0.;
+                for (int k = 0; k < SIMDWIDTH; k++)
+                    sum += acc[j][k];
+                for (int i = nv; i < n; i++)
+                    sum += tile[i] * tile[i + s0 + j];
+                sums[s0 + j] += sum;
+            }
+        }
+    }
+
+    for (int s = 0; s < MAXSHIFTS; s++)
+    {
+        PPSums[s] = (float)sums[s];
+    }
+    delete[] sums;
 }